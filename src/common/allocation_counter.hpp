@@ -0,0 +1,103 @@
+#ifndef CPSOLVER_COMMON_ALLOCATION_COUNTER_HPP
+#define CPSOLVER_COMMON_ALLOCATION_COUNTER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Counts every heap allocation the program makes, its own and its libraries',
+// by replacing the global operator new. Only built with
+// CPSOLVER_COUNT_ALLOCATIONS defined (the CMake option of the same name), so
+// other builds keep the default allocator. Replacements may only be defined
+// once per program, so include this from the translation unit with main alone
+// (each example is a single one). The array and nothrow forms fall back on
+// these by default.
+#ifdef CPSOLVER_COUNT_ALLOCATIONS
+inline constexpr bool allocations_counted = true;
+
+inline std::atomic<std::uint64_t> allocation_count = 0;
+inline std::atomic<std::uint64_t> allocation_bytes = 0;
+
+void * operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (auto * memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    auto align = static_cast<std::size_t>(alignment);
+    if (auto * memory = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+// Kept out of line: inlined, GCC sees free() called on what operator new
+// returned and warns of a mismatch
+[[gnu::noinline]] void operator delete(void * memory) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void * memory, std::size_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void * memory, std::align_val_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void * memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+#else
+inline constexpr bool allocations_counted = false;
+
+inline std::atomic<std::uint64_t> allocation_count = 0;
+inline std::atomic<std::uint64_t> allocation_bytes = 0;
+#endif
+
+// Allocations made between consecutive mark() calls, for --alloc-report.
+// Without CPSOLVER_COUNT_ALLOCATIONS nothing is counted and print() says so.
+class AllocationReport {
+public:
+    AllocationReport() : count_(allocation_count.load()), bytes_(allocation_bytes.load())
+    {
+        // Keeps mark() from allocating inside the phases it measures
+        phases_.reserve(8);
+    }
+
+    // Closes the phase that began at the previous mark (or at construction)
+    void mark(const std::string & phase)
+    {
+        auto count = allocation_count.load();
+        auto bytes = allocation_bytes.load();
+        phases_.push_back({phase, count - count_, bytes - bytes_});
+        count_ = count;
+        bytes_ = bytes;
+    }
+
+    void print(std::ostream & out) const
+    {
+        if (!allocations_counted) {
+            out << "Allocations by phase: not counted (build with -DCPSOLVER_COUNT_ALLOCATIONS=ON)\n";
+            return;
+        }
+        out << "Allocations by phase:\n";
+        for (const auto & phase : phases_) {
+            out << "  " << phase.name << ": " << phase.count << " allocations, " << phase.bytes << " bytes\n";
+        }
+    }
+
+private:
+    struct Phase {
+        std::string name;
+        std::uint64_t count;
+        std::uint64_t bytes;
+    };
+
+    std::uint64_t count_;
+    std::uint64_t bytes_;
+    std::vector<Phase> phases_ = {};
+};
+
+#endif
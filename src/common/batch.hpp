@@ -0,0 +1,69 @@
+#ifndef CPSOLVER_COMMON_BATCH_HPP
+#define CPSOLVER_COMMON_BATCH_HPP
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "parameters.hpp"
+#include "selection_mask.hpp"
+#include "thread_pool.hpp"
+
+// Scenarios for a batch run: either a JSON array of parameter objects or one
+// object per line (NDJSON), read from `file_path` or, for "-", from stdin.
+// Each object becomes Parameters through the from_json the caller has in
+// scope for Json; taking Json as a parameter keeps this header free of any
+// particular copy of json.hpp.
+template<typename Json>
+std::vector<Parameters> read_scenarios(const std::string & file_path)
+{
+    std::string text;
+    if (file_path == "-") {
+        text.assign(std::istreambuf_iterator<char>(std::cin), {});
+    } else {
+        std::ifstream in(file_path, std::ios::binary);
+        if (!in) {
+            throw std::invalid_argument("cannot open " + file_path);
+        }
+        text.assign(std::istreambuf_iterator<char>(in), {});
+    }
+
+    std::vector<Parameters> scenarios;
+    auto first = text.find_first_not_of(" \n\r\t");
+    if (first != std::string::npos && text[first] == '[') {
+        for (const auto & element : Json::parse(text)) {
+            scenarios.push_back(element.template get<Parameters>());
+        }
+        return scenarios;
+    }
+
+    std::size_t begin = 0;
+    while (begin < text.size()) {
+        auto end = text.find('\n', begin);
+        end = end == std::string::npos ? text.size() : end;
+        auto line = text.substr(begin, end - begin);
+        if (line.find_first_not_of(" \r\t") != std::string::npos) {
+            scenarios.push_back(Json::parse(line).template get<Parameters>());
+        }
+        begin = end + 1;
+    }
+    return scenarios;
+}
+
+// Runs solve(params) for every scenario on `pool` and returns the selections
+// in scenario order. `solve` is called concurrently, so everything it shares
+// (the catalog, orders, tables) must only be read.
+template<typename Solve>
+std::vector<SelectionMask> solve_batch(const std::vector<Parameters> & scenarios, ThreadPool & pool, Solve solve)
+{
+    std::vector<SelectionMask> results(scenarios.size());
+    parallel_for(pool, scenarios.size(), [&](std::size_t k) {
+        results[k] = solve(scenarios[k]);
+    });
+    return results;
+}
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef CPSOLVER_COMMON_BRANCH_AND_BOUND_HPP
+#define CPSOLVER_COMMON_BRANCH_AND_BOUND_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "candidates.hpp"
+#include "catalog.hpp"
+#include "order.hpp"
+#include "parameters.hpp"
+#include "selection_mask.hpp"
+
+struct BranchAndBoundResult {
+    // Empty when nothing reaches params.min_value, or beats the value to beat
+    SelectionMask selected = {};
+    std::size_t nodes = 0;
+    // False when the node limit cut the search short; selected is then the best found
+    bool optimal = false;
+};
+
+// Depth-first branch and bound for the capacity-only problem with a value
+// floor (e1 / e3). Needs no solver library.
+//
+// Items are searched in order of value per unit of the surrogate capacity
+// w / max_weight + v / max_volume, taking an item before leaving it out. A
+// node is cut when the incumbent already reaches an upper bound on what the
+// remaining items can add. That bound is the tightest of three one-dimensional
+// relaxations (weight only, volume only, surrogate), each bounded the
+// Martello-Toth way: the Dantzig fractional fill, tightened by deciding the
+// break item both ways.
+//
+// Given the value of a known selection (to_beat), only strictly better ones
+// are searched for, so the bounds cut from the first node on.
+class BranchAndBound {
+public:
+    BranchAndBound(const Catalog & catalog, const Parameters & params, std::size_t node_limit, Amount to_beat = 0)
+        : catalog_(catalog), params_(params), node_limit_(node_limit), to_beat_(to_beat)
+    {
+        std::vector<std::uint32_t> candidates;
+        capacity_candidates(catalog, params, candidates, free_);
+
+        // w / W + v / V scaled by W * V; doubles keep large capacities from overflowing
+        const auto max_weight = static_cast<double>(params.max_weight);
+        const auto max_volume = static_cast<double>(params.max_volume);
+        items_.reserve(candidates.size());
+        for (auto i : candidates) {
+            const auto & item = catalog.items[i];
+            auto weight = static_cast<double>(item.weight);
+            auto volume = static_cast<double>(item.volume);
+            items_.push_back({item.value, item.weight, item.volume,
+                {weight, volume, weight * max_volume + volume * max_weight}, i});
+        }
+
+        auto primary = density_order(Dimension::surrogate);
+        std::vector<Candidate> sorted;
+        sorted.reserve(items_.size());
+        for (auto k : primary) {
+            sorted.push_back(items_[k]);
+        }
+        items_ = std::move(sorted);
+
+        primary_ = identity_order(items_.size());
+        by_weight_ = density_order(Dimension::weight);
+        by_volume_ = density_order(Dimension::volume);
+        current_.assign(items_.size(), false);
+        best_ = current_;
+    }
+
+    BranchAndBoundResult run()
+    {
+        Amount start = 0;
+        for (auto i : free_) {
+            start += catalog_.items[i].value;
+        }
+        best_value_ = std::max(start, to_beat_);
+        search(0, params_.max_weight, params_.max_volume, start);
+
+        BranchAndBoundResult result;
+        result.selected = SelectionMask(catalog_.items.size());
+        result.nodes = nodes_;
+        result.optimal = !stopped_;
+        if (best_value_ == 0 || best_value_ < params_.min_value || (best_value_ == to_beat_ && !improved_)) {
+            return result;
+        }
+        for (auto i : free_) {
+            result.selected.set(i);
+        }
+        for (std::size_t k = 0; k < items_.size(); ++k) {
+            if (best_[k]) {
+                result.selected.set(items_[k].index);
+            }
+        }
+        return result;
+    }
+
+private:
+    // Which of Candidate::size a relaxation keeps
+    enum class Dimension : std::size_t { weight, volume, surrogate };
+
+    static constexpr std::size_t index(Dimension dimension) { return static_cast<std::size_t>(dimension); }
+
+    struct Candidate {
+        Amount value;
+        Amount weight;
+        Amount volume;
+        std::array<double, 3> size;
+        std::uint32_t index;
+    };
+
+    // Positions into items_ by value per unit of one dimension, densest first.
+    // Items without size in that dimension come first.
+    Order density_order(Dimension dimension) const
+    {
+        std::vector<double> density(items_.size());
+        for (std::size_t k = 0; k < items_.size(); ++k) {
+            auto size = items_[k].size[index(dimension)];
+            density[k] = size == 0.0 ? std::numeric_limits<double>::infinity() :
+                static_cast<double>(items_[k].value) / size;
+        }
+        return sorted_order(items_.size(), [&density](std::uint32_t a, std::uint32_t b) {
+            return density[a] > density[b];
+        });
+    }
+
+    bool fits(const Candidate & item, Amount weight_left, Amount volume_left) const
+    {
+        return item.weight <= weight_left && item.volume <= volume_left;
+    }
+
+    // Martello-Toth bound on the value items at or past depth can add within
+    // capacity in one dimension, walking them in the given density order.
+    // Items that cannot fit on their own are left out.
+    double relaxed_bound(const Order & order, std::size_t depth, Dimension dimension, double capacity,
+        Amount weight_left, Amount volume_left) const
+    {
+        double total = 0.0;
+        const Candidate * last = nullptr;
+        // The primary order is the identity, so everything before depth is skipped outright
+        auto it = &order == &primary_ ? order.begin() + static_cast<std::ptrdiff_t>(depth) : order.begin();
+        for (; it != order.end(); ++it) {
+            if (*it < depth || !fits(items_[*it], weight_left, volume_left)) {
+                continue;
+            }
+            const auto & item = items_[*it];
+            if (item.size[index(dimension)] > capacity) {
+                break;
+            }
+            capacity -= item.size[index(dimension)];
+            total += static_cast<double>(item.value);
+            last = &item;
+        }
+        if (it == order.end()) {
+            return total;
+        }
+
+        const auto & split = items_[*it];
+        auto dantzig = total + capacity * static_cast<double>(split.value) / split.size[index(dimension)];
+
+        // Leave the break item out: the next item fills what is left fractionally
+        const Candidate * next = nullptr;
+        for (++it; it != order.end() && next == nullptr; ++it) {
+            if (*it >= depth && fits(items_[*it], weight_left, volume_left)) {
+                next = &items_[*it];
+            }
+        }
+        if (last == nullptr || last->size[index(dimension)] == 0.0 || (next != nullptr && next->size[index(dimension)] == 0.0)) {
+            return dantzig;
+        }
+        auto without = total + (next == nullptr ? 0.0 :
+            capacity * static_cast<double>(next->value) / next->size[index(dimension)]);
+
+        // Take the break item: room is made by removing the tail of the last item taken
+        auto with = total + static_cast<double>(split.value) -
+            (split.size[index(dimension)] - capacity) * static_cast<double>(last->value) / last->size[index(dimension)];
+
+        return std::min(dantzig, std::max(without, with));
+    }
+
+    double bound(std::size_t depth, Amount weight_left, Amount volume_left) const
+    {
+        const auto max_volume = static_cast<double>(params_.max_volume);
+        const auto max_weight = static_cast<double>(params_.max_weight);
+        auto surrogate_left = static_cast<double>(weight_left) * max_volume + static_cast<double>(volume_left) * max_weight;
+
+        auto best = relaxed_bound(primary_, depth, Dimension::surrogate, surrogate_left, weight_left, volume_left);
+        best = std::min(best, relaxed_bound(by_weight_, depth, Dimension::weight, static_cast<double>(weight_left), weight_left, volume_left));
+        best = std::min(best, relaxed_bound(by_volume_, depth, Dimension::volume, static_cast<double>(volume_left), weight_left, volume_left));
+        return best;
+    }
+
+    // Takes items depth, depth + 1, ... while they fit (recursing on each),
+    // then backtracks by leaving them out; only takes recurse, so the stack
+    // stays as deep as the largest selection
+    void search(std::size_t depth, Amount weight_left, Amount volume_left, Amount value)
+    {
+        if (value > best_value_) {
+            best_value_ = value;
+            best_ = current_;
+            improved_ = true;
+        }
+
+        for (; depth < items_.size(); ++depth) {
+            const auto & item = items_[depth];
+            if (!fits(item, weight_left, volume_left)) {
+                continue;
+            }
+            if (++nodes_ > node_limit_) {
+                stopped_ = true;
+                return;
+            }
+            // Values are integers: only a bound reaching best + 1 can improve
+            constexpr double slack = 1e-6;
+            if (static_cast<double>(value) + bound(depth, weight_left, volume_left) < static_cast<double>(best_value_ + 1) - slack) {
+                return;
+            }
+
+            current_[depth] = true;
+            search(depth + 1, weight_left - item.weight, volume_left - item.volume, value + item.value);
+            current_[depth] = false;
+            if (stopped_) {
+                return;
+            }
+        }
+    }
+
+    const Catalog & catalog_;
+    const Parameters & params_;
+    std::size_t node_limit_;
+    Amount to_beat_;
+    std::vector<std::uint32_t> free_ = {};
+    std::vector<Candidate> items_ = {};
+    Order primary_ = {};
+    Order by_weight_ = {};
+    Order by_volume_ = {};
+    std::vector<bool> current_ = {};
+    std::vector<bool> best_ = {};
+    Amount best_value_ = 0;
+    std::size_t nodes_ = 0;
+    bool improved_ = false;
+    bool stopped_ = false;
+};
+
+// Nodes branch_and_bound explores before settling for the best selection found.
+// Each node bounds the remaining items in O(n), and large cores rarely close
+// the gap by depth-first search alone, so this stays at a few seconds; past it
+// the result is a heuristic one (BranchAndBoundResult::optimal is false).
+constexpr std::size_t default_node_limit = 1'000'000;
+
+inline BranchAndBoundResult branch_and_bound(const Catalog & catalog, const Parameters & params,
+    std::size_t node_limit = default_node_limit, Amount to_beat = 0)
+{
+    BranchAndBound search(catalog, params, node_limit, to_beat);
+    return search.run();
+}
+
+#endif
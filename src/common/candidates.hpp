@@ -0,0 +1,66 @@
+#ifndef CPSOLVER_COMMON_CANDIDATES_HPP
+#define CPSOLVER_COMMON_CANDIDATES_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "catalog.hpp"
+#include "parameters.hpp"
+
+// Items worth handing to an exact capacity-only engine (knapsack_dp,
+// branch_and_bound). Oversized and worthless items can never
+// be in an optimum. Of items sharing a (weight, volume) pair, at most
+// min(max_weight / weight, max_volume / volume) fit together, so only that
+// many of the most valuable ones are kept. Items weighing nothing at all are
+// returned separately; they are always taken.
+inline void capacity_candidates(const Catalog & catalog, const Parameters & params,
+    std::vector<std::uint32_t> & candidates, std::vector<std::uint32_t> & free)
+{
+    const auto & items = catalog.items;
+
+    std::vector<std::uint32_t> eligible;
+    eligible.reserve(items.size());
+    for (std::uint32_t i = 0; i < items.size(); ++i) {
+        const auto & item = items[i];
+        if (item.value == 0 || item.weight > params.max_weight || item.volume > params.max_volume) {
+            continue;
+        }
+        if (item.weight == 0 && item.volume == 0) {
+            free.push_back(i);
+        } else {
+            eligible.push_back(i);
+        }
+    }
+
+    std::sort(eligible.begin(), eligible.end(), [&items](std::uint32_t a, std::uint32_t b) {
+        if (items[a].weight != items[b].weight) {
+            return items[a].weight < items[b].weight;
+        }
+        if (items[a].volume != items[b].volume) {
+            return items[a].volume < items[b].volume;
+        }
+        return items[a].value != items[b].value ? items[a].value > items[b].value : a < b;
+    });
+
+    constexpr auto unbounded = std::numeric_limits<Amount>::max();
+    for (std::size_t begin = 0; begin < eligible.size();) {
+        const auto & first = items[eligible[begin]];
+        auto fit = std::min(
+            first.weight == 0 ? unbounded : params.max_weight / first.weight,
+            first.volume == 0 ? unbounded : params.max_volume / first.volume);
+
+        std::size_t end = begin;
+        for (Amount kept = 0; end < eligible.size() &&
+            items[eligible[end]].weight == first.weight &&
+            items[eligible[end]].volume == first.volume; ++end, ++kept) {
+            if (kept < fit) {
+                candidates.push_back(eligible[end]);
+            }
+        }
+        begin = end;
+    }
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef CPSOLVER_COMMON_CAPACITY_GREEDY_HPP
+#define CPSOLVER_COMMON_CAPACITY_GREEDY_HPP
+
+#include <cstdint>
+
+#include "catalog.hpp"
+#include "order.hpp"
+#include "parameters.hpp"
+#include "selection_mask.hpp"
+#include "selection_state.hpp"
+
+// Takes every item in `order` that still fits within max_weight and
+// max_volume. Ignores the value floor and the share limits.
+inline SelectionMask capacity_greedy(const Catalog & catalog, const Parameters & params, const Order & order)
+{
+    const auto & items = catalog.items;
+
+    SelectionMask selected(items.size());
+    SelectionState state(catalog, params.max_weight, params.max_volume);
+    for (auto i : order) {
+        if (!state.can_add(items[i])) {
+            continue;
+        }
+
+        state.add(items[i]);
+        selected.set(i);
+    }
+    return selected;
+}
+
+// As above over a LazyOrder, stopping as soon as no remaining item fits, so
+// that only as much of the order gets sorted as the pass actually reaches.
+// `items` is catalog.items or a copy of it in another layout (CompactItem).
+template<typename Items, typename Compare>
+SelectionMask capacity_greedy(const Catalog & catalog, const Items & items, const Parameters & params, LazyOrder<Compare> & order)
+{
+    SelectionMask selected(items.size());
+    SelectionState state(catalog, params.max_weight, params.max_volume);
+    auto fits = [&](std::uint32_t i) { return state.can_add(items[i]); };
+    for (std::uint32_t i = 0; order.next(i, fits);) {
+        if (!state.can_add(items[i])) {
+            continue;
+        }
+
+        state.add(items[i]);
+        selected.set(i);
+    }
+    return selected;
+}
+
+#endif
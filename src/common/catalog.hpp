@@ -0,0 +1,84 @@
+#ifndef CPSOLVER_COMMON_CATALOG_HPP
+#define CPSOLVER_COMMON_CATALOG_HPP
+
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "item.hpp"
+
+// Interns category names into dense ids (0, 1, 2, ...) in order of first
+// appearance and keeps the reverse mapping for output. Copies share the names
+// until one of them interns a new one, so a catalog derived from another
+// (reduce_to_core, once per solve) copies no strings.
+class Dictionary {
+public:
+    CategoryId intern(std::string_view name)
+    {
+        auto it = names_->ids.find(name);
+        if (it != names_->ids.end()) {
+            return it->second;
+        }
+
+        if (names_.use_count() > 1) {
+            names_ = std::make_shared<Names>(*names_);
+        }
+        auto id = static_cast<CategoryId>(names_->names.size());
+        names_->names.emplace_back(name);
+        names_->ids.emplace(names_->names.back(), id);
+        return id;
+    }
+
+    const std::string & name(CategoryId id) const { return names_->names[id]; }
+    std::size_t size() const { return names_->names.size(); }
+
+private:
+    struct NameHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    struct Names {
+        std::vector<std::string> names = {};
+        std::unordered_map<std::string, CategoryId, NameHash, std::equal_to<>> ids = {};
+    };
+
+    std::shared_ptr<Names> names_ = std::make_shared<Names>();
+};
+
+// An item as it appears in the input, before its categories are interned
+struct ItemRecord {
+    Amount value;
+    Amount weight;
+    Amount volume;
+    std::string manufacturer;
+    std::string type;
+};
+
+// The loaded items together with the dictionaries their category ids refer to
+struct Catalog {
+    std::vector<Item> items = {};
+    Dictionary manufacturers = {};
+    Dictionary types = {};
+
+    Catalog() = default;
+
+    Catalog(std::initializer_list<ItemRecord> records)
+    {
+        items.reserve(records.size());
+        for (const auto & record : records) {
+            add(record.value, record.weight, record.volume, record.manufacturer, record.type);
+        }
+    }
+
+    void add(Amount value, Amount weight, Amount volume, std::string_view manufacturer, std::string_view type)
+    {
+        items.push_back({value, weight, volume, manufacturers.intern(manufacturer), types.intern(type)});
+    }
+};
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef CPSOLVER_COMMON_CATALOG_BINARY_HPP
+#define CPSOLVER_COMMON_CATALOG_BINARY_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "catalog.hpp"
+#include "mapped_file.hpp"
+
+// Binary columnar catalog, version 1. Little-endian throughout; every section
+// starts on an 8-byte boundary so the columns can be used in place.
+//
+//   BinaryCatalogHeader
+//   values, weights, volumes      item_count x uint64
+//   manufacturers, types          item_count x uint32 category ids
+//   manufacturer names, type names
+//       uint64 count, (count + 1) x uint64 offsets into the bytes that follow,
+//       then the names back to back
+//
+// Each section carries a checksum64 of its bytes and the header one of itself.
+static_assert(std::endian::native == std::endian::little, "the binary catalog format is little-endian");
+
+constexpr std::array<char, 8> binary_catalog_magic = {'C', 'P', 'S', 'C', 'A', 'T', 'L', 'G'};
+constexpr std::uint32_t binary_catalog_version = 1;
+
+enum class CatalogSection : std::uint32_t {
+    values, weights, volumes, manufacturers, types, manufacturer_names, type_names, count
+};
+
+struct BinaryCatalogSection {
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint64_t checksum;
+};
+
+struct BinaryCatalogHeader {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t section_count;
+    std::uint64_t item_count;
+    std::array<BinaryCatalogSection, static_cast<std::size_t>(CatalogSection::count)> sections;
+    // checksum64 of every header byte before this field
+    std::uint64_t header_checksum;
+};
+
+// Word-at-a-time FNV-style hash; only meant to catch truncation and corruption
+inline std::uint64_t checksum64(std::string_view bytes)
+{
+    constexpr std::uint64_t prime = 0x100000001B3ULL;
+    std::uint64_t hash = 0xCBF29CE484222325ULL ^ bytes.size();
+
+    std::size_t i = 0;
+    for (; i + 8 <= bytes.size(); i += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes.data() + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for (; i < bytes.size(); ++i) {
+        hash = (hash ^ static_cast<unsigned char>(bytes[i])) * prime;
+    }
+    return hash;
+}
+
+inline bool is_binary_catalog(std::string_view bytes)
+{
+    return bytes.size() >= binary_catalog_magic.size() &&
+        std::equal(binary_catalog_magic.begin(), binary_catalog_magic.end(), bytes.begin());
+}
+
+// Writes `catalog` in the binary format
+inline void write_binary_catalog(const Catalog & catalog, const std::string & file_path)
+{
+    const auto & items = catalog.items;
+    std::array<std::string, static_cast<std::size_t>(CatalogSection::count)> sections;
+
+    auto put = [](std::string & out, auto number) {
+        out.append(reinterpret_cast<const char *>(&number), sizeof(number));
+    };
+    for (const auto & item : items) {
+        put(sections[0], std::uint64_t{item.value});
+        put(sections[1], std::uint64_t{item.weight});
+        put(sections[2], std::uint64_t{item.volume});
+        put(sections[3], std::uint32_t{item.manufacturer});
+        put(sections[4], std::uint32_t{item.type});
+    }
+
+    auto put_names = [&put](std::string & out, const Dictionary & dictionary) {
+        put(out, std::uint64_t{dictionary.size()});
+        std::uint64_t offset = 0;
+        for (CategoryId id = 0; id < dictionary.size(); ++id) {
+            put(out, offset);
+            offset += dictionary.name(id).size();
+        }
+        put(out, offset);
+        for (CategoryId id = 0; id < dictionary.size(); ++id) {
+            out += dictionary.name(id);
+        }
+    };
+    put_names(sections[5], catalog.manufacturers);
+    put_names(sections[6], catalog.types);
+
+    auto align = [](std::uint64_t offset) { return (offset + 7) & ~std::uint64_t{7}; };
+
+    BinaryCatalogHeader header = {};
+    header.magic = binary_catalog_magic;
+    header.version = binary_catalog_version;
+    header.section_count = static_cast<std::uint32_t>(CatalogSection::count);
+    header.item_count = items.size();
+    std::uint64_t offset = align(sizeof(header));
+    for (std::size_t s = 0; s < sections.size(); ++s) {
+        header.sections[s] = {offset, sections[s].size(), checksum64(sections[s])};
+        offset = align(offset + sections[s].size());
+    }
+    header.header_checksum = checksum64({reinterpret_cast<const char *>(&header), offsetof(BinaryCatalogHeader, header_checksum)});
+
+    std::ofstream out(file_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("cannot write " + file_path);
+    }
+    const char padding[8] = {};
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(padding, static_cast<std::streamsize>(header.sections[0].offset - sizeof(header)));
+    for (std::size_t s = 0; s < sections.size(); ++s) {
+        out.write(sections[s].data(), static_cast<std::streamsize>(sections[s].size()));
+        out.write(padding, static_cast<std::streamsize>(align(sections[s].size()) - sections[s].size()));
+    }
+    if (!out) {
+        throw std::runtime_error("failed writing " + file_path);
+    }
+}
+
+// A mapped binary catalog. The header and checksums are verified on opening;
+// after that the columns and names are views straight into the mapping.
+class BinaryCatalog {
+public:
+    explicit BinaryCatalog(MappedFile file) : file_(std::move(file))
+    {
+        auto bytes = file_.view();
+        if (!is_binary_catalog(bytes) || bytes.size() < sizeof(BinaryCatalogHeader)) {
+            throw std::invalid_argument("not a binary catalog");
+        }
+        std::memcpy(&header_, bytes.data(), sizeof(header_));
+        if (header_.version != binary_catalog_version) {
+            throw std::invalid_argument("unsupported binary catalog version " + std::to_string(header_.version));
+        }
+        if (header_.section_count != static_cast<std::uint32_t>(CatalogSection::count) ||
+            header_.header_checksum != checksum64(bytes.substr(0, offsetof(BinaryCatalogHeader, header_checksum)))) {
+            throw std::invalid_argument("corrupt binary catalog header");
+        }
+
+        for (std::size_t s = 0; s < header_.sections.size(); ++s) {
+            const auto & section = header_.sections[s];
+            if (section.offset % 8 != 0 || section.offset > bytes.size() || section.size > bytes.size() - section.offset ||
+                checksum64(bytes.substr(section.offset, section.size)) != section.checksum) {
+                throw std::invalid_argument("corrupt binary catalog section " + std::to_string(s));
+            }
+        }
+
+        const auto n = header_.item_count;
+        if (n > bytes.size() / sizeof(Amount)) {
+            throw std::invalid_argument("corrupt binary catalog item count");
+        }
+        for (auto s : {CatalogSection::values, CatalogSection::weights, CatalogSection::volumes}) {
+            check_size(s, n * sizeof(Amount));
+        }
+        for (auto s : {CatalogSection::manufacturers, CatalogSection::types}) {
+            check_size(s, n * sizeof(CategoryId));
+        }
+        manufacturer_names_ = names(CatalogSection::manufacturer_names);
+        type_names_ = names(CatalogSection::type_names);
+    }
+
+    std::size_t size() const { return header_.item_count; }
+
+    std::span<const Amount> values() const { return column<Amount>(CatalogSection::values); }
+    std::span<const Amount> weights() const { return column<Amount>(CatalogSection::weights); }
+    std::span<const Amount> volumes() const { return column<Amount>(CatalogSection::volumes); }
+    std::span<const CategoryId> manufacturers() const { return column<CategoryId>(CatalogSection::manufacturers); }
+    std::span<const CategoryId> types() const { return column<CategoryId>(CatalogSection::types); }
+
+    const std::vector<std::string_view> & manufacturer_names() const { return manufacturer_names_; }
+    const std::vector<std::string_view> & type_names() const { return type_names_; }
+
+    // Copies the columns into the row-wise Catalog the solvers take, so this,
+    // unlike the accessors above, is not zero-copy: mapping and verifying cost
+    // no copies, but every item is then copied once into an Item. Category ids
+    // carry over unchanged since the names are interned in id order.
+    Catalog to_catalog() const
+    {
+        Catalog catalog;
+        for (auto name : manufacturer_names_) {
+            catalog.manufacturers.intern(name);
+        }
+        for (auto name : type_names_) {
+            catalog.types.intern(name);
+        }
+        if (catalog.manufacturers.size() != manufacturer_names_.size() || catalog.types.size() != type_names_.size()) {
+            throw std::invalid_argument("binary catalog dictionary has duplicate names");
+        }
+
+        auto values_column = values();
+        auto weights_column = weights();
+        auto volumes_column = volumes();
+        auto manufacturers_column = manufacturers();
+        auto types_column = types();
+        catalog.items.resize(size());
+        for (std::size_t i = 0; i < size(); ++i) {
+            if (manufacturers_column[i] >= manufacturer_names_.size() || types_column[i] >= type_names_.size()) {
+                throw std::invalid_argument("binary catalog item " + std::to_string(i) + " has an unknown category");
+            }
+            catalog.items[i] = {values_column[i], weights_column[i], volumes_column[i], manufacturers_column[i], types_column[i]};
+        }
+        return catalog;
+    }
+
+private:
+    const BinaryCatalogSection & section(CatalogSection s) const { return header_.sections[static_cast<std::size_t>(s)]; }
+
+    void check_size(CatalogSection s, std::uint64_t expected) const
+    {
+        if (section(s).size != expected) {
+            throw std::invalid_argument("binary catalog column has the wrong size");
+        }
+    }
+
+    template<typename T>
+    std::span<const T> column(CatalogSection s) const
+    {
+        // Sections are 8-byte aligned within a page-aligned mapping
+        auto data = static_cast<const char *>(file_.data()) + section(s).offset;
+        return {reinterpret_cast<const T *>(data), size()};
+    }
+
+    std::vector<std::string_view> names(CatalogSection s) const
+    {
+        auto bytes = file_.view().substr(section(s).offset, section(s).size);
+        auto read = [&bytes](std::size_t at) {
+            std::uint64_t number;
+            std::memcpy(&number, bytes.data() + at, sizeof(number));
+            return number;
+        };
+
+        if (bytes.size() < sizeof(std::uint64_t)) {
+            throw std::invalid_argument("truncated binary catalog dictionary");
+        }
+        // The count and the offsets after it must fit: count + 2 words
+        auto count = read(0);
+        if (bytes.size() < 2 * sizeof(std::uint64_t) || count > bytes.size() / sizeof(std::uint64_t) - 2) {
+            throw std::invalid_argument("truncated binary catalog dictionary");
+        }
+        const auto blob = sizeof(std::uint64_t) * (count + 2);
+
+        std::vector<std::string_view> result;
+        result.reserve(count);
+        for (std::uint64_t k = 0; k < count; ++k) {
+            auto begin = read(sizeof(std::uint64_t) * (k + 1));
+            auto end = read(sizeof(std::uint64_t) * (k + 2));
+            if (begin > end || end > bytes.size() - blob) {
+                throw std::invalid_argument("corrupt binary catalog dictionary");
+            }
+            result.push_back(bytes.substr(blob + begin, end - begin));
+        }
+        return result;
+    }
+
+    MappedFile file_;
+    BinaryCatalogHeader header_ = {};
+    std::vector<std::string_view> manufacturer_names_ = {};
+    std::vector<std::string_view> type_names_ = {};
+};
+
+#endif
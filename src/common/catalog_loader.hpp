@@ -0,0 +1,36 @@
+#ifndef CPSOLVER_COMMON_CATALOG_LOADER_HPP
+#define CPSOLVER_COMMON_CATALOG_LOADER_HPP
+
+#include <stdexcept>
+#include <string>
+
+#include "catalog.hpp"
+#include "catalog_parser.hpp"
+#include "catalog_reader.hpp"
+#include "options.hpp"
+#include "parallel_catalog_parser.hpp"
+#include "thread_pool.hpp"
+
+// Loads the items file with the loader `--loader` names:
+//   mmap (default)  map_catalog, the file parsed in place on one thread
+//   parallel        map_catalog_parallel on `--threads` threads (default: all cores)
+//   sax             read_catalog<Json>, nlohmann's SAX parser over an ifstream
+// Both mmap loaders also take binary catalogs, see catalog_binary.hpp.
+template<typename Json>
+Catalog load_catalog(const std::string & file_path, const Options & options)
+{
+    auto loader = options.get("loader", "mmap");
+    if (loader == "mmap") {
+        return map_catalog(file_path);
+    }
+    if (loader == "parallel") {
+        ThreadPool pool(static_cast<std::size_t>(options.get_long("threads", static_cast<long>(ThreadPool::default_size()))));
+        return map_catalog_parallel(file_path, pool);
+    }
+    if (loader == "sax") {
+        return read_catalog<Json>(file_path);
+    }
+    throw std::invalid_argument("unknown loader: " + loader);
+}
+
+#endif
@@ -0,0 +1,374 @@
+#ifndef CPSOLVER_COMMON_CATALOG_PARSER_HPP
+#define CPSOLVER_COMMON_CATALOG_PARSER_HPP
+
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "catalog.hpp"
+#include "catalog_binary.hpp"
+#include "mapped_file.hpp"
+
+// Hand-written parser for the flat item schema
+//   [{"value": 1, "weight": 2, "volume": 3, "manufacturer": "...", "product_type": "..."}, ...]
+// reading straight out of the text. Amounts are read in place and category
+// names are passed to the dictionaries as string_views into the text (only
+// names with escapes go through a scratch buffer), so nothing but the
+// Catalog itself is allocated. Other keys are skipped, whatever their value.
+class CatalogParser {
+public:
+    CatalogParser(std::string_view text, Catalog & catalog)
+        : begin_(text.data()), pos_(text.data()), end_(text.data() + text.size()), catalog_(catalog)
+    {
+    }
+
+    CatalogParser(const CatalogParser &) = delete;
+    CatalogParser & operator=(const CatalogParser &) = delete;
+
+    void parse()
+    {
+        expect('[');
+        if (!consume(']')) {
+            skip_space();
+            if (!parse_items(end_)) {
+                fail("unterminated item array");
+            }
+        }
+        finish();
+    }
+
+    // Parses the items from byte `offset`, which must be the start of an item
+    // object, up to the first item that starts at or past byte `limit`, and
+    // returns that item's offset. Returns npos if the array ended instead.
+    // Lets a caller parse the array in pieces, see parallel_catalog_parser.hpp.
+    std::size_t parse_chunk(std::size_t offset, std::size_t limit)
+    {
+        pos_ = begin_ + offset;
+        if (!parse_items(begin_ + limit)) {
+            return static_cast<std::size_t>(pos_ - begin_);
+        }
+        finish();
+        return std::string_view::npos;
+    }
+
+    // Parses the text as one item object on its own, as a line of NDJSON holds
+    void parse_object()
+    {
+        skip_space();
+        parse_item();
+        finish();
+    }
+
+private:
+    enum Field : unsigned { value, weight, volume, manufacturer, type, field_count };
+
+    // Returns true at the end of the array, false when stopped at `limit`
+    bool parse_items(const char * limit)
+    {
+        const auto first = pos_;
+        const auto count = catalog_.items.size();
+        for (;;) {
+            parse_item();
+            if (catalog_.items.size() == count + 1) {
+                // The first item is a fair sample of how much text one takes
+                auto per_item = static_cast<std::size_t>(pos_ - first);
+                catalog_.items.reserve(count + static_cast<std::size_t>(limit - first) / per_item + 1);
+            }
+            if (!consume(',')) {
+                expect(']');
+                return true;
+            }
+            skip_space();
+            if (pos_ >= limit) {
+                return false;
+            }
+        }
+    }
+
+    void finish()
+    {
+        skip_space();
+        if (pos_ != end_) {
+            fail("trailing characters after the items");
+        }
+    }
+
+    void parse_item()
+    {
+        Amount amounts[3] = {};
+        std::string_view names[2];
+        unsigned seen = 0;
+
+        expect('{');
+        if (!consume('}')) {
+            do {
+                auto field = parse_key();
+                expect(':');
+                if (field < manufacturer) {
+                    amounts[field] = parse_amount();
+                } else if (field < field_count) {
+                    names[field - manufacturer] = parse_string(scratch_[field - manufacturer]);
+                } else {
+                    skip_value();
+                    continue;
+                }
+                seen |= 1U << field;
+            } while (consume(','));
+            expect('}');
+        }
+
+        if (seen != (1U << field_count) - 1) {
+            static constexpr const char * keys[] = {"value", "weight", "volume", "manufacturer", "product_type"};
+            for (unsigned f = 0; f < field_count; ++f) {
+                if ((seen & (1U << f)) == 0) {
+                    fail("item " + std::to_string(catalog_.items.size()) + " has no \"" + keys[f] + "\"");
+                }
+            }
+        }
+        catalog_.add(amounts[value], amounts[weight], amounts[volume], names[0], names[1]);
+    }
+
+    unsigned parse_key()
+    {
+        auto key = parse_string(key_scratch_);
+        if (key == "value") {
+            return value;
+        }
+        if (key == "weight") {
+            return weight;
+        }
+        if (key == "volume") {
+            return volume;
+        }
+        if (key == "manufacturer") {
+            return manufacturer;
+        }
+        if (key == "product_type") {
+            return type;
+        }
+        return field_count;
+    }
+
+    Amount parse_amount()
+    {
+        skip_space();
+        if (pos_ != end_ && *pos_ == '-') {
+            fail("amounts must not be negative");
+        }
+
+        Amount amount = 0;
+        auto start = pos_;
+        for (; pos_ != end_ && *pos_ >= '0' && *pos_ <= '9'; ++pos_) {
+            auto digit = static_cast<Amount>(*pos_ - '0');
+            if (amount > (std::numeric_limits<Amount>::max() - digit) / 10) {
+                fail("amount out of range");
+            }
+            amount = amount * 10 + digit;
+        }
+        if (pos_ == start) {
+            fail("expected a number");
+        }
+
+        // Fractions and exponents are rare enough to take the slow path, truncated as nlohmann does
+        if (pos_ != end_ && (*pos_ == '.' || *pos_ == 'e' || *pos_ == 'E')) {
+            double number = 0.0;
+            auto [next, error] = std::from_chars(start, end_, number);
+            if (error != std::errc()) {
+                fail("malformed number");
+            }
+            pos_ = next;
+            amount = static_cast<Amount>(number);
+        }
+        return amount;
+    }
+
+    // A view into the text, or into `scratch` when the string has escapes to decode
+    std::string_view parse_string(std::string & scratch)
+    {
+        expect('"');
+        auto start = pos_;
+        while (pos_ != end_ && *pos_ != '"' && *pos_ != '\\') {
+            ++pos_;
+        }
+        if (pos_ == end_) {
+            fail("unterminated string");
+        }
+        if (*pos_ == '"') {
+            return {start, static_cast<std::size_t>(pos_++ - start)};
+        }
+
+        scratch.assign(start, pos_);
+        while (pos_ != end_ && *pos_ != '"') {
+            if (*pos_ != '\\') {
+                scratch.push_back(*pos_++);
+                continue;
+            }
+            if (++pos_ == end_) {
+                break;
+            }
+            switch (*pos_++) {
+                case '"': scratch.push_back('"'); break;
+                case '\\': scratch.push_back('\\'); break;
+                case '/': scratch.push_back('/'); break;
+                case 'b': scratch.push_back('\b'); break;
+                case 'f': scratch.push_back('\f'); break;
+                case 'n': scratch.push_back('\n'); break;
+                case 'r': scratch.push_back('\r'); break;
+                case 't': scratch.push_back('\t'); break;
+                case 'u': append_code_point(scratch); break;
+                default: fail("invalid escape");
+            }
+        }
+        if (pos_ == end_) {
+            fail("unterminated string");
+        }
+        ++pos_;
+        return scratch;
+    }
+
+    unsigned parse_hex4()
+    {
+        if (end_ - pos_ < 4) {
+            fail("truncated \\u escape");
+        }
+        unsigned unit = 0;
+        auto [next, error] = std::from_chars(pos_, pos_ + 4, unit, 16);
+        if (error != std::errc() || next != pos_ + 4) {
+            fail("invalid \\u escape");
+        }
+        pos_ = next;
+        return unit;
+    }
+
+    void append_code_point(std::string & out)
+    {
+        auto code = parse_hex4();
+        if (code >= 0xD800 && code <= 0xDBFF) {
+            if (end_ - pos_ < 2 || pos_[0] != '\\' || pos_[1] != 'u') {
+                fail("unpaired surrogate");
+            }
+            pos_ += 2;
+            auto low = parse_hex4();
+            if (low < 0xDC00 || low > 0xDFFF) {
+                fail("unpaired surrogate");
+            }
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        }
+
+        auto put = [&out](unsigned byte) { out.push_back(static_cast<char>(byte)); };
+        if (code < 0x80) {
+            put(code);
+        } else if (code < 0x800) {
+            put(0xC0 | (code >> 6));
+            put(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            put(0xE0 | (code >> 12));
+            put(0x80 | ((code >> 6) & 0x3F));
+            put(0x80 | (code & 0x3F));
+        } else {
+            put(0xF0 | (code >> 18));
+            put(0x80 | ((code >> 12) & 0x3F));
+            put(0x80 | ((code >> 6) & 0x3F));
+            put(0x80 | (code & 0x3F));
+        }
+    }
+
+    // Skips any JSON value; only the structure is checked, not literal spelling
+    void skip_value()
+    {
+        skip_space();
+        if (pos_ == end_) {
+            fail("expected a value");
+        }
+        if (*pos_ == '"') {
+            parse_string(key_scratch_);
+            return;
+        }
+        if (*pos_ == '{' || *pos_ == '[') {
+            auto close = *pos_ == '{' ? '}' : ']';
+            ++pos_;
+            if (consume(close)) {
+                return;
+            }
+            do {
+                if (close == '}') {
+                    parse_string(key_scratch_);
+                    expect(':');
+                }
+                skip_value();
+            } while (consume(','));
+            expect(close);
+            return;
+        }
+        auto start = pos_;
+        while (pos_ != end_ && *pos_ != ',' && *pos_ != '}' && *pos_ != ']' && !is_space(*pos_)) {
+            ++pos_;
+        }
+        if (pos_ == start) {
+            fail("expected a value");
+        }
+    }
+
+    static bool is_space(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+    void skip_space()
+    {
+        while (pos_ != end_ && is_space(*pos_)) {
+            ++pos_;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skip_space();
+        if (pos_ != end_ && *pos_ == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c)
+    {
+        if (!consume(c)) {
+            fail(std::string("expected '") + c + "'");
+        }
+    }
+
+    [[noreturn]] void fail(const std::string & problem) const
+    {
+        throw std::invalid_argument(problem + " at byte " + std::to_string(pos_ - begin_));
+    }
+
+    const char * begin_;
+    const char * pos_;
+    const char * end_;
+    Catalog & catalog_;
+    std::string scratch_[2] = {};
+    std::string key_scratch_ = {};
+};
+
+inline Catalog parse_catalog(std::string_view text)
+{
+    Catalog catalog;
+    CatalogParser(text, catalog).parse();
+    return catalog;
+}
+
+// Maps the file and parses it in place, or copies the columns out of it if it
+// is a binary catalog; the mapping is gone by the time this returns, as the
+// dictionaries own copies of the names
+inline Catalog map_catalog(const std::string & file_path)
+{
+    MappedFile file(file_path);
+    if (is_binary_catalog(file.view())) {
+        return BinaryCatalog(std::move(file)).to_catalog();
+    }
+    return parse_catalog(file.view());
+}
+
+#endif
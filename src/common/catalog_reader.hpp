@@ -0,0 +1,203 @@
+#ifndef CPSOLVER_COMMON_CATALOG_READER_HPP
+#define CPSOLVER_COMMON_CATALOG_READER_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "catalog.hpp"
+
+// nlohmann SAX handler that adds each item of a JSON array straight to a
+// Catalog, so no DOM of the whole file is ever built. Json is the
+// nlohmann::basic_json in use; taking it as a parameter keeps this header from
+// pulling in a particular copy of json.hpp.
+//
+// Expects [{"value": ..., "weight": ..., "volume": ..., "manufacturer": "...",
+// "product_type": "..."}, ...]. Other keys are skipped, whatever their value.
+template<typename Json>
+class CatalogSax {
+public:
+    using number_integer_t = typename Json::number_integer_t;
+    using number_unsigned_t = typename Json::number_unsigned_t;
+    using number_float_t = typename Json::number_float_t;
+    using string_t = typename Json::string_t;
+    using binary_t = typename Json::binary_t;
+
+    explicit CatalogSax(Catalog & catalog) : catalog_(catalog) {}
+
+    bool null() { return scalar(); }
+    bool boolean(bool) { return scalar(); }
+    bool binary(binary_t &) { return scalar(); }
+
+    bool number_integer(number_integer_t number)
+    {
+        if (number < 0 && amount_field() != nullptr) {
+            fail("must not be negative");
+        }
+        return number_unsigned(static_cast<number_unsigned_t>(number));
+    }
+
+    bool number_unsigned(number_unsigned_t number)
+    {
+        if (auto field = amount_field()) {
+            *field = static_cast<Amount>(number);
+            seen_ |= bit(field_);
+        }
+        return scalar();
+    }
+
+    bool number_float(number_float_t number, const string_t &)
+    {
+        if (number < 0 && amount_field() != nullptr) {
+            fail("must not be negative");
+        }
+        return number_unsigned(static_cast<number_unsigned_t>(number));
+    }
+
+    bool string(string_t & text)
+    {
+        if (depth_ == item_depth && (field_ == Field::manufacturer || field_ == Field::type)) {
+            (field_ == Field::manufacturer ? manufacturer_ : type_).assign(text);
+            seen_ |= bit(field_);
+        }
+        return scalar();
+    }
+
+    bool start_object(std::size_t)
+    {
+        if (depth_ == 0) {
+            throw std::invalid_argument("expected an array of items");
+        }
+        if (depth_ == item_depth - 1) {
+            seen_ = 0;
+        }
+        ++depth_;
+        return true;
+    }
+
+    bool end_object()
+    {
+        if (--depth_ == item_depth - 1) {
+            finish_item();
+        }
+        field_ = Field::other;
+        return true;
+    }
+
+    bool start_array(std::size_t)
+    {
+        ++depth_;
+        return true;
+    }
+
+    bool end_array()
+    {
+        --depth_;
+        field_ = Field::other;
+        return true;
+    }
+
+    bool key(string_t & name)
+    {
+        if (depth_ != item_depth) {
+            return true;
+        }
+        if (name == "value") {
+            field_ = Field::value;
+        } else if (name == "weight") {
+            field_ = Field::weight;
+        } else if (name == "volume") {
+            field_ = Field::volume;
+        } else if (name == "manufacturer") {
+            field_ = Field::manufacturer;
+        } else if (name == "product_type") {
+            field_ = Field::type;
+        } else {
+            field_ = Field::other;
+        }
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, const typename Json::exception & error)
+    {
+        throw error;
+    }
+
+private:
+    // The array is depth 1, each item object depth 2
+    static constexpr int item_depth = 2;
+
+    enum class Field { value, weight, volume, manufacturer, type, other };
+
+    static constexpr unsigned bit(Field field) { return 1U << static_cast<unsigned>(field); }
+    static constexpr unsigned all_fields =
+        bit(Field::value) | bit(Field::weight) | bit(Field::volume) | bit(Field::manufacturer) | bit(Field::type);
+
+    // Only the item's own keys count; a key's value may be nested deeper
+    bool scalar()
+    {
+        if (depth_ == item_depth) {
+            field_ = Field::other;
+        }
+        return true;
+    }
+
+    Amount * amount_field()
+    {
+        if (depth_ != item_depth) {
+            return nullptr;
+        }
+        switch (field_) {
+            case Field::value: return &value_;
+            case Field::weight: return &weight_;
+            case Field::volume: return &volume_;
+            default: return nullptr;
+        }
+    }
+
+    void finish_item()
+    {
+        if ((seen_ & all_fields) != all_fields) {
+            static constexpr const char * names[] = {"value", "weight", "volume", "manufacturer", "product_type"};
+            for (unsigned f = 0; f < 5; ++f) {
+                if ((seen_ & (1U << f)) == 0) {
+                    throw std::invalid_argument("item " + std::to_string(catalog_.items.size()) + " has no \"" + names[f] + "\"");
+                }
+            }
+        }
+        catalog_.add(value_, weight_, volume_, manufacturer_, type_);
+    }
+
+    [[noreturn]] void fail(const char * problem) const
+    {
+        throw std::invalid_argument("item " + std::to_string(catalog_.items.size()) + ": amount " + problem);
+    }
+
+    Catalog & catalog_;
+    int depth_ = 0;
+    Field field_ = Field::other;
+    unsigned seen_ = 0;
+    Amount value_ = 0;
+    Amount weight_ = 0;
+    Amount volume_ = 0;
+    std::string manufacturer_ = {};
+    std::string type_ = {};
+};
+
+// Loads a catalog file with CatalogSax
+template<typename Json>
+Catalog read_catalog(const std::string & file_path)
+{
+    std::ifstream input(file_path);
+    if (!input) {
+        throw std::runtime_error("cannot open " + file_path);
+    }
+
+    Catalog catalog;
+    CatalogSax<Json> handler(catalog);
+    Json::sax_parse(input, &handler);
+    return catalog;
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef CPSOLVER_COMMON_CATALOG_STREAM_HPP
+#define CPSOLVER_COMMON_CATALOG_STREAM_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "catalog.hpp"
+#include "catalog_parser.hpp"
+#include "parameters.hpp"
+
+// The items of a stream that can still be in an optimal capacity-only
+// selection, kept as they arrive. This is capacity_candidates done online: of
+// the items sharing a (weight, volume) pair only the
+// min(max_weight / weight, max_volume / volume) most valuable are held, in a
+// min-heap per pair, so the pool is bounded by the capacities rather than by
+// the length of the stream. Items weighing nothing are always taken and kept
+// apart.
+class CandidatePool {
+public:
+    explicit CandidatePool(const Parameters & params) : params_(params) {}
+
+    void offer(const Item & item)
+    {
+        auto sequence = seen_++;
+        if (item.value == 0 || item.weight > params_.max_weight || item.volume > params_.max_volume) {
+            return;
+        }
+        if (item.weight == 0 && item.volume == 0) {
+            free_.push_back({item, sequence});
+            return;
+        }
+
+        auto & heap = classes_[{item.weight, item.volume}];
+        if (heap.size() < fit(item)) {
+            heap.push_back({item, sequence});
+            std::push_heap(heap.begin(), heap.end(), more_valuable);
+            ++size_;
+        } else if (item.value > heap.front().item.value) {
+            std::pop_heap(heap.begin(), heap.end(), more_valuable);
+            heap.back() = {item, sequence};
+            std::push_heap(heap.begin(), heap.end(), more_valuable);
+        }
+    }
+
+    // Items offered so far, and how many of them are held
+    std::uint64_t seen() const { return seen_; }
+    std::size_t size() const { return size_ + free_.size(); }
+
+    // The held items in the order they arrived
+    std::vector<Item> items() const
+    {
+        std::vector<Candidate> held(free_);
+        for (const auto & [dimensions, heap] : classes_) {
+            held.insert(held.end(), heap.begin(), heap.end());
+        }
+        std::sort(held.begin(), held.end(), [](const Candidate & a, const Candidate & b) {
+            return a.sequence < b.sequence;
+        });
+
+        std::vector<Item> result;
+        result.reserve(held.size());
+        for (const auto & candidate : held) {
+            result.push_back(candidate.item);
+        }
+        return result;
+    }
+
+private:
+    struct Candidate {
+        Item item;
+        std::uint64_t sequence;
+    };
+
+    struct SizeHash {
+        std::size_t operator()(const std::pair<Amount, Amount> & dimensions) const
+        {
+            return std::hash<Amount>{}(dimensions.first * 0x9E3779B97F4A7C15ULL ^ dimensions.second);
+        }
+    };
+
+    // Heap order that keeps the least valuable candidate at the front
+    static bool more_valuable(const Candidate & a, const Candidate & b) { return a.item.value > b.item.value; }
+
+    std::size_t fit(const Item & item) const
+    {
+        constexpr auto unbounded = std::numeric_limits<Amount>::max();
+        auto count = std::min(
+            item.weight == 0 ? unbounded : params_.max_weight / item.weight,
+            item.volume == 0 ? unbounded : params_.max_volume / item.volume);
+        return static_cast<std::size_t>(std::min<Amount>(count, std::numeric_limits<std::size_t>::max()));
+    }
+
+    Parameters params_;
+    std::unordered_map<std::pair<Amount, Amount>, std::vector<Candidate>, SizeHash> classes_ = {};
+    std::vector<Candidate> free_ = {};
+    std::uint64_t seen_ = 0;
+    std::size_t size_ = 0;
+};
+
+// Reads newline-delimited items, one object per line in the schema of
+// CatalogParser, offering each to `pool`. Blank lines are skipped. The
+// returned Catalog holds the dictionaries of every name seen and the items
+// the pool kept; memory beyond that is one line.
+inline Catalog stream_catalog(std::istream & in, CandidatePool & pool)
+{
+    Catalog catalog;
+    std::string line;
+    for (std::uint64_t number = 1; std::getline(in, line); ++number) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        try {
+            CatalogParser(line, catalog).parse_object();
+        } catch (const std::invalid_argument & e) {
+            throw std::invalid_argument("line " + std::to_string(number) + ": " + e.what());
+        }
+        pool.offer(catalog.items.back());
+        catalog.items.pop_back();
+    }
+    if (in.bad()) {
+        throw std::runtime_error("error reading the item stream");
+    }
+
+    catalog.items = pool.items();
+    return catalog;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef CPSOLVER_COMMON_COMPACT_ITEMS_HPP
+#define CPSOLVER_COMMON_COMPACT_ITEMS_HPP
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "catalog.hpp"
+
+// Item in 16 bytes, for the passes that touch every item of a large catalog
+// in random order (sorting, partitioning, greedy scans): four to a cache line
+// instead of two. The generated catalogs have values up to 100, weights up to
+// 50, volumes up to 25 and a handful of categories, far inside these fields.
+// The fields keep Item's names, so code templated on the item type reads
+// either; totals are still summed as Amount, so nothing narrows but storage.
+struct CompactItem {
+    std::uint32_t value;
+    std::uint32_t weight;
+    std::uint32_t volume;
+    std::uint16_t manufacturer;
+    std::uint16_t type;
+};
+
+static_assert(sizeof(CompactItem) == 16);
+
+// Whether every item of the catalog fits a CompactItem without losing anything
+inline bool fits_compact(const Catalog & catalog)
+{
+    constexpr Amount max_amount = std::numeric_limits<std::uint32_t>::max();
+    constexpr std::size_t max_categories = std::size_t{std::numeric_limits<std::uint16_t>::max()} + 1;
+    if (catalog.manufacturers.size() > max_categories || catalog.types.size() > max_categories) {
+        return false;
+    }
+
+    Amount widest = 0;
+    for (const auto & item : catalog.items) {
+        widest |= item.value | item.weight | item.volume;
+    }
+    return widest <= max_amount;
+}
+
+// The catalog's items as CompactItems; only valid when fits_compact(catalog)
+inline std::vector<CompactItem> compact_items(const Catalog & catalog)
+{
+    std::vector<CompactItem> items;
+    items.reserve(catalog.items.size());
+    for (const auto & item : catalog.items) {
+        items.push_back({static_cast<std::uint32_t>(item.value), static_cast<std::uint32_t>(item.weight),
+            static_cast<std::uint32_t>(item.volume), static_cast<std::uint16_t>(item.manufacturer),
+            static_cast<std::uint16_t>(item.type)});
+    }
+    return items;
+}
+
+// Calls f with the catalog's items in the narrowest layout the data allows: a
+// CompactItem copy when every item fits one, the catalog's own Items
+// otherwise. f is instantiated for both, so it must only use the common field
+// names.
+template<typename F>
+decltype(auto) with_compact_items(const Catalog & catalog, F f)
+{
+    if (fits_compact(catalog)) {
+        const auto items = compact_items(catalog);
+        return f(items);
+    }
+    return f(catalog.items);
+}
+
+#endif
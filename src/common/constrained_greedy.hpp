@@ -0,0 +1,263 @@
+#ifndef CPSOLVER_COMMON_CONSTRAINED_GREEDY_HPP
+#define CPSOLVER_COMMON_CONSTRAINED_GREEDY_HPP
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "catalog.hpp"
+#include "constraints.hpp"
+#include "order.hpp"
+#include "parameters.hpp"
+#include "selection_mask.hpp"
+#include "selection_state.hpp"
+
+// shortfall() for one move at a time in O(1) rather than O(categories). The
+// largest category requirement and the runner-up are found once for the
+// current selection; a move only changes one manufacturer and one type, so
+// the rest of each maximum is whichever of the two is not that category.
+class ShortfallProbe {
+public:
+    ShortfallProbe(const SelectionState & state, const Parameters & params)
+        : state_(state), params_(params),
+        manufacturers_(top_two(state.manufacturer_values(), params.high_man_max)),
+        types_(top_two(state.type_values(), params.high_type_max))
+    {
+    }
+
+    // shortfall(state, params)
+    double current() const
+    {
+        auto required = std::max(static_cast<double>(params_.min_value),
+            static_cast<double>(state_.max_value()) / params_.high_value_max);
+        required = std::max({required, manufacturers_.first, types_.first});
+        return required - static_cast<double>(state_.value());
+    }
+
+    // shortfall(state, params, &item)
+    double with_added(const Item & item) const
+    {
+        auto total = static_cast<double>(state_.value()) + static_cast<double>(item.value);
+        auto max_value = std::max(state_.max_value(), item.value);
+        return required(max_value, item, static_cast<double>(item.value)) - total;
+    }
+
+    // shortfall(state, params, nullptr, &item)
+    double with_removed(const Item & item) const
+    {
+        auto total = static_cast<double>(state_.value()) - static_cast<double>(item.value);
+        auto max_value = state_.max_value_without(item.value);
+        return required(max_value, item, -static_cast<double>(item.value)) - total;
+    }
+
+private:
+    struct TopTwo {
+        double first;
+        CategoryId first_id;
+        double second;
+
+        double excluding(CategoryId c) const { return c == first_id ? second : first; }
+    };
+
+    static TopTwo top_two(const std::vector<Amount> & values, double limit)
+    {
+        constexpr auto none = -std::numeric_limits<double>::infinity();
+        TopTwo top = {none, 0, none};
+        for (CategoryId c = 0; c < values.size(); ++c) {
+            auto share = static_cast<double>(values[c]) / limit;
+            if (share > top.first) {
+                top.second = top.first;
+                top = {share, c, top.second};
+            } else if (share > top.second) {
+                top.second = share;
+            }
+        }
+        return top;
+    }
+
+    // The largest requirement once `item`'s manufacturer and type change by `delta`
+    double required(Amount max_value, const Item & item, double delta) const
+    {
+        const auto & manufacturer_values = state_.manufacturer_values();
+        const auto & type_values = state_.type_values();
+        auto manufacturer = (static_cast<double>(manufacturer_values[item.manufacturer]) + delta) / params_.high_man_max;
+        auto type = (static_cast<double>(type_values[item.type]) + delta) / params_.high_type_max;
+        return std::max({static_cast<double>(params_.min_value),
+            static_cast<double>(max_value) / params_.high_value_max,
+            manufacturers_.excluding(item.manufacturer), manufacturer,
+            types_.excluding(item.type), type});
+    }
+
+    const SelectionState & state_;
+    const Parameters & params_;
+    TopTwo manufacturers_;
+    TopTwo types_;
+};
+
+// Repair: add the first item in `order` that brings the selection closer to
+// valid (see shortfall), or else drop the selected item whose removal helps
+// most, until the selection is valid or no single move helps. Each candidate
+// move is scored in O(1) by a ShortfallProbe of the current selection.
+inline void repair(const Catalog & catalog, const Parameters & params, const Order & order,
+    SelectionState & state, SelectionMask & selected)
+{
+    const auto & items = catalog.items;
+    const auto n = items.size();
+
+    for (std::size_t step = 0; step < n && !satisfies(state, params); ++step) {
+        ShortfallProbe probe(state, params);
+        auto current = probe.current();
+
+        bool added = false;
+        for (auto i : order) {
+            if (!selected.test(i) && state.can_add(items[i]) && probe.with_added(items[i]) < current) {
+                state.add(items[i]);
+                selected.set(i);
+                added = true;
+                break;
+            }
+        }
+        if (added) {
+            continue;
+        }
+
+        auto drop = n;
+        auto best = current;
+        selected.for_each([&](std::size_t i) {
+            auto after = probe.with_removed(items[i]);
+            if (after < best) {
+                best = after;
+                drop = i;
+            }
+        });
+        if (drop == n) {
+            break;
+        }
+        state.remove(items[drop]);
+        selected.reset(drop);
+    }
+}
+
+// One attempt of constrained_greedy at `target`: items are admitted only
+// while their value, manufacturer and type stay within their share of the
+// target, and only if they pay their way towards it, i.e. bring at least the
+// target's share of the capacity they use (value >= target * weight /
+// max_weight, and the same for volume). The selection is then repaired and, if valid, filled with every
+// remaining item that keeps it so. Returns the total the capped pass reached
+// before repair.
+inline Amount constrained_pass(const Catalog & catalog, const Parameters & params, const Order & order,
+    double target, SelectionState & state, SelectionMask & selected)
+{
+    const auto & items = catalog.items;
+    state.clear();
+    selected.clear();
+
+    auto value_cap = params.high_value_max * target;
+    auto man_cap = params.high_man_max * target;
+    auto type_cap = params.high_type_max * target;
+    auto weight_rate = target / static_cast<double>(params.max_weight);
+    auto volume_rate = target / static_cast<double>(params.max_volume);
+
+    for (auto i : order) {
+        const auto & item = items[i];
+        auto value = static_cast<double>(item.value);
+        if (!state.can_add(item) ||
+            value < weight_rate * static_cast<double>(item.weight) ||
+            value < volume_rate * static_cast<double>(item.volume) ||
+            value > value_cap ||
+            static_cast<double>(state.manufacturer_values()[item.manufacturer] + item.value) > man_cap ||
+            static_cast<double>(state.type_values()[item.type] + item.value) > type_cap)
+        {
+            continue;
+        }
+        state.add(item);
+        selected.set(i);
+    }
+    auto reached = state.value();
+
+    repair(catalog, params, order, state, selected);
+
+    if (satisfies(state, params)) {
+        for (auto i : order) {
+            if (!selected.test(i) && still_satisfies_with(state, items[i], params)) {
+                state.add(items[i]);
+                selected.set(i);
+            }
+        }
+    }
+    return reached;
+}
+
+// Greedy over the full constraint set (capacity, value floor, largest item
+// share, manufacturer and product type shares), taking items in `order`.
+//
+// A plain capacity pass gives a first target total T, and constrained_pass
+// is tried at T and at targets around it:
+//   - upwards, doubling T: a higher target loosens the share caps and asks
+//     more value per unit of capacity, which suits small knapsacks where the
+//     plain pass fills up on a few large items; this stops once the capped
+//     pass takes just what the plain one did
+//   - downwards, for catalogs where the caps at T cannot be met: while a
+//     capped pass falls short of its target, the next target is what it
+//     reached
+// The most valuable valid selection is kept, the plain pass included if it
+// is valid itself. If none was found the plain pass is returned as is.
+inline SelectionMask constrained_greedy(const Catalog & catalog, const Parameters & params, const Order & order)
+{
+    constexpr int max_target_rounds = 8;
+
+    const auto & items = catalog.items;
+    const auto n = items.size();
+
+    SelectionState plain(catalog, params.max_weight, params.max_volume);
+    SelectionMask plain_selected(n);
+    for (auto i : order) {
+        const auto & item = items[i];
+        if (plain.can_add(item)) {
+            plain.add(item);
+            plain_selected.set(i);
+        }
+    }
+
+    SelectionMask best = plain_selected;
+    Amount best_value = 0;
+    bool found = satisfies(plain, params);
+    if (found) {
+        best_value = plain.value();
+    }
+
+    SelectionState state(catalog, params.max_weight, params.max_volume);
+    SelectionMask selected(n);
+    auto attempt = [&](double target) {
+        auto reached = constrained_pass(catalog, params, order, target, state, selected);
+        if (satisfies(state, params) && (!found || state.value() > best_value)) {
+            best = selected;
+            best_value = state.value();
+            found = true;
+        }
+        return static_cast<double>(reached);
+    };
+
+    const auto start = static_cast<double>(plain.value());
+    auto target = start;
+    for (int round = 0; round < max_target_rounds; ++round) {
+        target *= 2;
+        attempt(target);
+        if (selected.words() == plain_selected.words()) {
+            break;
+        }
+    }
+
+    target = start;
+    for (int round = 0; round < max_target_rounds && target > 0; ++round) {
+        auto reached = attempt(target);
+        if (reached >= target) {
+            break;
+        }
+        target = reached;
+    }
+
+    return best;
+}
+
+#endif
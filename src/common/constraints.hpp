@@ -0,0 +1,124 @@
+#ifndef CPSOLVER_COMMON_CONSTRAINTS_HPP
+#define CPSOLVER_COMMON_CONSTRAINTS_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "parameters.hpp"
+#include "selection_state.hpp"
+
+// The share test check_valid applies: above the limit is invalid, equal is fine
+inline bool exceeds_share(Amount amount, Amount total, double limit)
+{
+    return static_cast<double>(amount) / static_cast<double>(total) > limit;
+}
+
+// Whether a selection meets every constraint in params
+inline bool satisfies(const SelectionState & state, const Parameters & params)
+{
+    if (state.count() == 0 || state.over_capacity() || state.value() < params.min_value) {
+        return false;
+    }
+
+    auto total = state.value();
+    if (exceeds_share(state.max_value(), total, params.high_value_max)) {
+        return false;
+    }
+    for (auto amount : state.manufacturer_values()) {
+        if (exceeds_share(amount, total, params.high_man_max)) {
+            return false;
+        }
+    }
+    for (auto amount : state.type_values()) {
+        if (exceeds_share(amount, total, params.high_type_max)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether a selection that already satisfies params still does once item is
+// added. Adding value only dilutes the other categories, so just the item's own
+// manufacturer, type and value need checking.
+inline bool still_satisfies_with(const SelectionState & state, const Item & item, const Parameters & params)
+{
+    if (!state.can_add(item)) {
+        return false;
+    }
+
+    auto total = state.value() + item.value;
+    return !exceeds_share(std::max(state.max_value(), item.value), total, params.high_value_max) &&
+        !exceeds_share(state.manufacturer_values()[item.manufacturer] + item.value, total, params.high_man_max) &&
+        !exceeds_share(state.type_values()[item.type] + item.value, total, params.high_type_max);
+}
+
+// Whether a currently valid selection stays valid when `in` replaces `out_a`
+// (and `out_b`, if given). Only meant for swaps that raise the total: every
+// other category and the old largest value then only lose share, so checking
+// capacity and `in`'s own shares is enough.
+inline bool improving_swap_keeps_valid(const SelectionState & state, const Parameters & params,
+    const Item & in, const Item & out_a, const Item * out_b = nullptr)
+{
+    auto freed_weight = out_a.weight + (out_b != nullptr ? out_b->weight : 0);
+    auto freed_volume = out_a.volume + (out_b != nullptr ? out_b->volume : 0);
+    if (in.weight > state.remaining_weight() + freed_weight || in.volume > state.remaining_volume() + freed_volume) {
+        return false;
+    }
+
+    auto same_manufacturer = [&](const Item & out) { return out.manufacturer == in.manufacturer ? out.value : 0; };
+    auto same_type = [&](const Item & out) { return out.type == in.type ? out.value : 0; };
+
+    auto manufacturer_value = state.manufacturer_values()[in.manufacturer] + in.value - same_manufacturer(out_a);
+    auto type_value = state.type_values()[in.type] + in.value - same_type(out_a);
+    auto total = state.value() + in.value - out_a.value;
+    if (out_b != nullptr) {
+        manufacturer_value -= same_manufacturer(*out_b);
+        type_value -= same_type(*out_b);
+        total -= out_b->value;
+    }
+
+    return !exceeds_share(in.value, total, params.high_value_max) &&
+        !exceeds_share(manufacturer_value, total, params.high_man_max) &&
+        !exceeds_share(type_value, total, params.high_type_max);
+}
+
+// How much total value the selection lacks before the value floor and every
+// share limit hold: the largest of min_value, max value / high_value_max and
+// each category total / its limit, minus the current total. Optionally scores
+// the selection as if `added` were added and/or `removed` taken out, without
+// touching the state.
+inline double shortfall(const SelectionState & state, const Parameters & params,
+    const Item * added = nullptr, const Item * removed = nullptr)
+{
+    auto total = static_cast<double>(state.value());
+    auto max_value = state.max_value();
+    if (removed != nullptr) {
+        total -= static_cast<double>(removed->value);
+        max_value = state.max_value_without(removed->value);
+    }
+    if (added != nullptr) {
+        total += static_cast<double>(added->value);
+        max_value = std::max(max_value, added->value);
+    }
+
+    auto required = std::max(static_cast<double>(params.min_value), static_cast<double>(max_value) / params.high_value_max);
+
+    auto by_category = [&](const std::vector<Amount> & values, CategoryId Item::* member, double limit) {
+        for (CategoryId c = 0; c < values.size(); ++c) {
+            auto amount = static_cast<double>(values[c]);
+            if (added != nullptr && added->*member == c) {
+                amount += static_cast<double>(added->value);
+            }
+            if (removed != nullptr && removed->*member == c) {
+                amount -= static_cast<double>(removed->value);
+            }
+            required = std::max(required, amount / limit);
+        }
+    };
+    by_category(state.manufacturer_values(), &Item::manufacturer, params.high_man_max);
+    by_category(state.type_values(), &Item::type, params.high_type_max);
+
+    return required - total;
+}
+
+#endif
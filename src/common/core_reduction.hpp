@@ -0,0 +1,221 @@
+#ifndef CPSOLVER_COMMON_CORE_REDUCTION_HPP
+#define CPSOLVER_COMMON_CORE_REDUCTION_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "catalog.hpp"
+#include "order.hpp"
+#include "parameters.hpp"
+#include "selection_mask.hpp"
+
+// What is left of a catalog after reduce_to_core: the undecided items plus
+// those fixed in, with the same dictionaries so category ids carry over.
+struct CoreProblem {
+    Catalog catalog = {};
+    // Over catalog.items: the items every selection better than the incumbent contains
+    SelectionMask fixed_in = {};
+    // catalog.items[k] is the original catalog's item original[k]
+    std::vector<std::uint32_t> original = {};
+    std::size_t fixed_out = 0;
+
+    // Items neither fixed in nor out; they come first in catalog.items
+    std::size_t undecided() const { return original.size() - fixed_in.count(); }
+
+    // Whether the reduction alone proves the incumbent optimal: every item is
+    // fixed out, or the items fixed in do not fit together. Fixed in only
+    // means "in every selection better than the incumbent", which says
+    // nothing once no such selection exists.
+    bool proves_incumbent(const Parameters & params) const
+    {
+        return catalog.items.empty() || fixed_in_total(&Item::weight) > params.max_weight ||
+            fixed_in_total(&Item::volume) > params.max_volume;
+    }
+
+    // For engines that take no fixed-in set (dp, bb): the undecided items
+    // alone, to be solved within remaining(params), the capacity and value
+    // floor the fixed-in items leave. expand_undecided adds those back.
+    Catalog undecided_catalog() const
+    {
+        Catalog result;
+        result.manufacturers = catalog.manufacturers;
+        result.types = catalog.types;
+        result.items.assign(catalog.items.begin(), catalog.items.begin() + static_cast<std::ptrdiff_t>(undecided()));
+        return result;
+    }
+
+    // Only meaningful when !proves_incumbent(params), so the fixed-in items fit
+    Parameters remaining(const Parameters & params) const
+    {
+        auto result = params;
+        result.max_weight -= fixed_in_total(&Item::weight);
+        result.max_volume -= fixed_in_total(&Item::volume);
+        auto value = fixed_in_total(&Item::value);
+        result.min_value = params.min_value > value ? params.min_value - value : 0;
+        return result;
+    }
+
+    // Maps a selection over undecided_catalog() back to the original catalog
+    // of `size` items, with the fixed-in items added
+    SelectionMask expand_undecided(const SelectionMask & selected, std::size_t size) const
+    {
+        auto result = expand(selected, size);
+        fixed_in.for_each([&](std::size_t k) {
+            result.set(original[k]);
+        });
+        return result;
+    }
+
+    Amount fixed_in_total(Amount Item::* field) const
+    {
+        Amount total = 0;
+        fixed_in.for_each([&](std::size_t k) {
+            total += catalog.items[k].*field;
+        });
+        return total;
+    }
+
+    // Maps a selection over catalog.items back to the original catalog of `size` items
+    SelectionMask expand(const SelectionMask & selected, std::size_t size) const
+    {
+        SelectionMask result(size);
+        selected.for_each([&](std::size_t k) {
+            result.set(original[k]);
+        });
+        return result;
+    }
+
+    // The reverse of expand: the items of an original-catalog selection that
+    // are in the core, over catalog.items. Fixed-out items are dropped.
+    SelectionMask restrict(const SelectionMask & selected) const
+    {
+        SelectionMask result(original.size());
+        for (std::size_t k = 0; k < original.size(); ++k) {
+            if (selected.test(original[k])) {
+                result.set(k);
+            }
+        }
+        return result;
+    }
+};
+
+// Fixes the items whose fate no selection worth more than lower_bound (the
+// value of a valid incumbent) can change, so that exact engines only see the
+// core around the break item.
+//
+// Dropping everything but capacity leaves three one-dimensional knapsacks
+// (weight, volume, and the surrogate w / max_weight + v / max_volume). For
+// each, the Dantzig solution gives an upper bound U and the break item's
+// density a dual price lambda. Forcing an item the LP leaves out (or forcing
+// out one it takes) costs at least |value - lambda * size|. An item is fixed
+// out when even the smallest bound with it forced in cannot reach
+// lower_bound + 1, and fixed in when the smallest bound without it cannot.
+// Either way every strictly better selection agrees, so callers solve the core
+// and keep the incumbent if that does not beat it.
+//
+// Only capacity is relaxed, so this holds for the share-constrained
+// problem too.
+inline CoreProblem reduce_to_core(const Catalog & catalog, const Parameters & params, Amount lower_bound)
+{
+    const auto & items = catalog.items;
+
+    CoreProblem core;
+    core.catalog.manufacturers = catalog.manufacturers;
+    core.catalog.types = catalog.types;
+
+    std::vector<std::uint32_t> eligible;
+    eligible.reserve(items.size());
+    for (std::uint32_t i = 0; i < items.size(); ++i) {
+        const auto & item = items[i];
+        if (item.value > 0 && item.weight <= params.max_weight && item.volume <= params.max_volume) {
+            eligible.push_back(i);
+        }
+    }
+
+    const auto max_weight = static_cast<double>(params.max_weight);
+    const auto max_volume = static_cast<double>(params.max_volume);
+    auto size = [&](const Item & item, std::size_t dimension) {
+        auto weight = static_cast<double>(item.weight);
+        auto volume = static_cast<double>(item.volume);
+        switch (dimension) {
+            case 0: return weight;
+            case 1: return volume;
+            default: return weight * max_volume + volume * max_weight;
+        }
+    };
+    const std::array<double, 3> capacity = {max_weight, max_volume, 2.0 * max_weight * max_volume};
+
+    std::array<double, 3> bound = {};
+    std::array<double, 3> price = {};
+    for (std::size_t d = 0; d < 3; ++d) {
+        std::vector<double> density(eligible.size());
+        for (std::size_t k = 0; k < eligible.size(); ++k) {
+            auto amount = size(items[eligible[k]], d);
+            density[k] = amount == 0.0 ? std::numeric_limits<double>::infinity() :
+                static_cast<double>(items[eligible[k]].value) / amount;
+        }
+        auto order = sorted_order(eligible.size(), [&density](std::uint32_t a, std::uint32_t b) {
+            return density[a] > density[b];
+        });
+
+        auto left = capacity[d];
+        double total = 0.0;
+        price[d] = 0.0;
+        for (auto k : order) {
+            const auto & item = items[eligible[k]];
+            auto amount = size(item, d);
+            if (amount > left) {
+                price[d] = density[k];
+                total += left * price[d];
+                break;
+            }
+            left -= amount;
+            total += static_cast<double>(item.value);
+        }
+        bound[d] = total;
+    }
+
+    // Values are integers, so only a bound reaching lower_bound + 1 leaves room to improve
+    constexpr double slack = 1e-6;
+    const auto needed = static_cast<double>(lower_bound) + 1.0 - slack;
+
+    std::vector<std::uint32_t> kept;
+    std::vector<std::uint32_t> fixed_in;
+    for (auto i : eligible) {
+        const auto & item = items[i];
+        auto with = std::numeric_limits<double>::infinity();
+        auto without = std::numeric_limits<double>::infinity();
+        for (std::size_t d = 0; d < 3; ++d) {
+            auto reduced = static_cast<double>(item.value) - price[d] * size(item, d);
+            with = std::min(with, bound[d] + std::min(reduced, 0.0));
+            without = std::min(without, bound[d] - std::max(reduced, 0.0));
+        }
+
+        if (with < needed) {
+            continue;
+        }
+        if (without < needed) {
+            fixed_in.push_back(i);
+        } else {
+            kept.push_back(i);
+        }
+    }
+
+    core.fixed_out = items.size() - kept.size() - fixed_in.size();
+    core.original = std::move(kept);
+    core.original.insert(core.original.end(), fixed_in.begin(), fixed_in.end());
+    core.catalog.items.reserve(core.original.size());
+    for (auto i : core.original) {
+        core.catalog.items.push_back(items[i]);
+    }
+    core.fixed_in = SelectionMask(core.original.size());
+    for (auto k = core.original.size() - fixed_in.size(); k < core.original.size(); ++k) {
+        core.fixed_in.set(k);
+    }
+    return core;
+}
+
+#endif
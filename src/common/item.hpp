@@ -0,0 +1,19 @@
+#ifndef CPSOLVER_COMMON_ITEM_HPP
+#define CPSOLVER_COMMON_ITEM_HPP
+
+#include <cstdint>
+
+using Amount = std::uint64_t;
+
+// Dense id of an interned manufacturer or product type, see Dictionary
+using CategoryId = std::uint32_t;
+
+struct Item {
+    Amount value;
+    Amount weight;
+    Amount volume;
+    CategoryId manufacturer;
+    CategoryId type;
+};
+
+#endif
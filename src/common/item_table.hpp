@@ -0,0 +1,263 @@
+#ifndef CPSOLVER_COMMON_ITEM_TABLE_HPP
+#define CPSOLVER_COMMON_ITEM_TABLE_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "catalog.hpp"
+#include "selection_mask.hpp"
+
+// Column-wise copy of the numeric fields of a catalog. Validation and
+// statistics only look at value, weight, volume and the category ids, so each
+// of those lives in its own contiguous array and the masked reductions below
+// stream through exactly the bytes they need.
+//
+// The generated catalogs stay far below 2^32 per field, so the columns are
+// 32 bit. A catalog with a larger value, weight or volume gets 64 bit columns
+// instead, reduced by plain scalar loops, the way with_compact_items falls
+// back to Item.
+class ItemTable {
+public:
+    using Column = std::vector<std::uint32_t>;
+    using WideColumn = std::vector<Amount>;
+
+    explicit ItemTable(const Catalog & catalog)
+        : manufacturer_count_(catalog.manufacturers.size()), type_count_(catalog.types.size())
+    {
+        constexpr Amount narrow_max = std::numeric_limits<std::uint32_t>::max();
+        wide_ = std::any_of(catalog.items.begin(), catalog.items.end(), [](const Item & item) {
+            return item.value > narrow_max || item.weight > narrow_max || item.volume > narrow_max;
+        });
+
+        auto size = catalog.items.size();
+        if (wide_) {
+            wide_values_.reserve(size);
+            wide_weights_.reserve(size);
+            wide_volumes_.reserve(size);
+        } else {
+            values_.reserve(size);
+            weights_.reserve(size);
+            volumes_.reserve(size);
+        }
+        manufacturers_.reserve(size);
+        types_.reserve(size);
+
+        for (const auto & item : catalog.items) {
+            if (wide_) {
+                wide_values_.push_back(item.value);
+                wide_weights_.push_back(item.weight);
+                wide_volumes_.push_back(item.volume);
+            } else {
+                values_.push_back(static_cast<std::uint32_t>(item.value));
+                weights_.push_back(static_cast<std::uint32_t>(item.weight));
+                volumes_.push_back(static_cast<std::uint32_t>(item.volume));
+            }
+            manufacturers_.push_back(item.manufacturer);
+            types_.push_back(item.type);
+        }
+    }
+
+    std::size_t size() const { return manufacturers_.size(); }
+    std::size_t manufacturer_count() const { return manufacturer_count_; }
+    std::size_t type_count() const { return type_count_; }
+
+    // Whether the amounts needed 64 bit columns. The 32 bit columns are then
+    // empty and the wide ones hold the data, and the other way round.
+    bool wide() const { return wide_; }
+
+    const Column & values() const { return values_; }
+    const Column & weights() const { return weights_; }
+    const Column & volumes() const { return volumes_; }
+    const WideColumn & wide_values() const { return wide_values_; }
+    const WideColumn & wide_weights() const { return wide_weights_; }
+    const WideColumn & wide_volumes() const { return wide_volumes_; }
+    const std::vector<CategoryId> & manufacturers() const { return manufacturers_; }
+    const std::vector<CategoryId> & types() const { return types_; }
+
+    Amount sum_value(const SelectionMask & mask) const
+    {
+        return wide_ ? wide_sum(wide_values_, mask) : masked_sum(values_, mask);
+    }
+
+    Amount sum_weight(const SelectionMask & mask) const
+    {
+        return wide_ ? wide_sum(wide_weights_, mask) : masked_sum(weights_, mask);
+    }
+
+    Amount sum_volume(const SelectionMask & mask) const
+    {
+        return wide_ ? wide_sum(wide_volumes_, mask) : masked_sum(volumes_, mask);
+    }
+
+    Amount max_value(const SelectionMask & mask) const
+    {
+        return wide_ ? wide_max(wide_values_, mask) : masked_max(values_, mask);
+    }
+
+    // Selected value per category, indexed by CategoryId
+    std::vector<Amount> value_by_manufacturer(const SelectionMask & mask) const
+    {
+        return masked_value_by(manufacturers_, manufacturer_count_, mask);
+    }
+
+    std::vector<Amount> value_by_type(const SelectionMask & mask) const
+    {
+        return masked_value_by(types_, type_count_, mask);
+    }
+
+private:
+    // Words of the mask with fewer selected items than this are walked bit by
+    // bit; denser words go through the vector kernels.
+    static constexpr int dense_word_bits = 8;
+
+    static Amount wide_sum(const WideColumn & column, const SelectionMask & mask)
+    {
+        Amount total = 0;
+        mask.for_each([&](std::size_t i) {
+            total += column[i];
+        });
+        return total;
+    }
+
+    static Amount wide_max(const WideColumn & column, const SelectionMask & mask)
+    {
+        Amount best = 0;
+        mask.for_each([&](std::size_t i) {
+            best = std::max(best, column[i]);
+        });
+        return best;
+    }
+
+    static bool sparse_word(const Column & column, std::size_t w, std::uint64_t word)
+    {
+        return std::popcount(word) < dense_word_bits || (w + 1) * 64 > column.size();
+    }
+
+    static Amount masked_sum(const Column & column, const SelectionMask & mask)
+    {
+        const auto & words = mask.words();
+        Amount total = 0;
+
+#if defined(__AVX2__)
+        const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        __m256i acc = _mm256_setzero_si256();
+#elif defined(__SSE2__)
+        const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+#endif
+
+        for (std::size_t w = 0; w < words.size(); ++w) {
+            auto word = words[w];
+            const auto * base = column.data() + w * 64;
+
+            if (sparse_word(column, w, word)) {
+                for (; word != 0; word &= word - 1) {
+                    total += base[std::countr_zero(word)];
+                }
+                continue;
+            }
+
+#if defined(__AVX2__)
+            for (unsigned lane = 0; lane < 64; lane += 8) {
+                auto bits = _mm256_set1_epi32(static_cast<int>((word >> lane) & 0xFF));
+                auto select = _mm256_cmpeq_epi32(_mm256_and_si256(bits, lane_bits), lane_bits);
+                auto vals = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + lane)), select);
+                acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(vals)));
+                acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(vals, 1)));
+            }
+#elif defined(__SSE2__)
+            for (unsigned lane = 0; lane < 64; lane += 4) {
+                auto bits = _mm_set1_epi32(static_cast<int>((word >> lane) & 0xF));
+                auto select = _mm_cmpeq_epi32(_mm_and_si128(bits, lane_bits), lane_bits);
+                auto vals = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(base + lane)), select);
+                acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(vals, zero));
+                acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(vals, zero));
+            }
+#else
+            for (unsigned lane = 0; lane < 64; ++lane) {
+                total += ((word >> lane) & 1) * base[lane];
+            }
+#endif
+        }
+
+#if defined(__AVX2__)
+        alignas(32) std::uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+        total += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+        alignas(16) std::uint64_t lanes[2];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc);
+        total += lanes[0] + lanes[1];
+#endif
+        return total;
+    }
+
+    static Amount masked_max(const Column & column, const SelectionMask & mask)
+    {
+        const auto & words = mask.words();
+        std::uint32_t best = 0;
+
+#if defined(__AVX2__)
+        const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        __m256i acc = _mm256_setzero_si256();
+#endif
+
+        for (std::size_t w = 0; w < words.size(); ++w) {
+            auto word = words[w];
+            const auto * base = column.data() + w * 64;
+
+#if defined(__AVX2__)
+            if (!sparse_word(column, w, word)) {
+                for (unsigned lane = 0; lane < 64; lane += 8) {
+                    auto bits = _mm256_set1_epi32(static_cast<int>((word >> lane) & 0xFF));
+                    auto select = _mm256_cmpeq_epi32(_mm256_and_si256(bits, lane_bits), lane_bits);
+                    auto vals = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + lane)), select);
+                    acc = _mm256_max_epu32(acc, vals);
+                }
+                continue;
+            }
+#endif
+            for (; word != 0; word &= word - 1) {
+                best = std::max(best, base[std::countr_zero(word)]);
+            }
+        }
+
+#if defined(__AVX2__)
+        alignas(32) std::uint32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+        best = std::max(best, *std::max_element(lanes, lanes + 8));
+#endif
+        return best;
+    }
+
+    std::vector<Amount> masked_value_by(const std::vector<CategoryId> & categories, std::size_t count, const SelectionMask & mask) const
+    {
+        std::vector<Amount> totals(count, 0);
+        mask.for_each([&](std::size_t i) {
+            totals[categories[i]] += wide_ ? wide_values_[i] : values_[i];
+        });
+        return totals;
+    }
+
+    std::size_t manufacturer_count_;
+    std::size_t type_count_;
+    Column values_ = {};
+    Column weights_ = {};
+    Column volumes_ = {};
+    bool wide_ = false;
+    WideColumn wide_values_ = {};
+    WideColumn wide_weights_ = {};
+    WideColumn wide_volumes_ = {};
+    std::vector<CategoryId> manufacturers_ = {};
+    std::vector<CategoryId> types_ = {};
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef CPSOLVER_COMMON_KNAPSACK_DP_HPP
+#define CPSOLVER_COMMON_KNAPSACK_DP_HPP
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "candidates.hpp"
+#include "catalog.hpp"
+#include "parameters.hpp"
+#include "selection_mask.hpp"
+
+// Largest (max_weight + 1) * (max_volume + 1) table the DP engine is picked for
+// automatically. 150 x 120 (the generator's params.json) is about 18k cells.
+constexpr std::size_t dp_max_cells = std::size_t{1} << 16;
+
+// Largest bitset dp_solve keeps to walk the choices back, in bytes. It holds a
+// bit per cell per item (8 KiB an item at dp_max_cells), so this caps the item
+// count too: 32k items at dp_max_cells.
+constexpr std::size_t dp_max_taken_bytes = std::size_t{1} << 28;
+
+// Whether the DP engine fits for item_count items: its table within
+// dp_max_cells and its bitset within dp_max_taken_bytes
+inline bool dp_applicable(const Parameters & params, std::size_t item_count)
+{
+    if (params.max_weight >= dp_max_cells || params.max_volume >= dp_max_cells ||
+        (params.max_weight + 1) * (params.max_volume + 1) > dp_max_cells) {
+        return false;
+    }
+    const auto rows = static_cast<std::size_t>(params.max_weight) + 1;
+    const auto words = (static_cast<std::size_t>(params.max_volume) + 1 + 63) / 64;
+    return item_count <= dp_max_taken_bytes / (rows * words * sizeof(std::uint64_t));
+}
+
+// row[i] = max(row[i], source[i] + value) for the first count columns, setting
+// bit offset + i for every column that improved
+template<typename Value>
+void dp_update_row(Value * row, const Value * source, std::size_t count, Value value,
+    std::uint64_t * bits, std::size_t offset)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        Value candidate = source[i] + value;
+        bool better = candidate > row[i];
+        row[i] = better ? candidate : row[i];
+        auto bit = offset + i;
+        bits[bit / 64] |= std::uint64_t{better} << (bit % 64);
+    }
+}
+
+#if defined(__AVX2__)
+inline void dp_update_row(std::uint32_t * row, const std::uint32_t * source, std::size_t count,
+    std::uint32_t value, std::uint64_t * bits, std::size_t offset)
+{
+    const __m256i add = _mm256_set1_epi32(static_cast<int>(value));
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto old = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+        auto candidate = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i)), add);
+        auto best = _mm256_max_epu32(old, candidate);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(row + i), best);
+
+        auto same = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(best, old))));
+        auto changed = std::uint64_t{~same & 0xFFu};
+        auto bit = offset + i;
+        bits[bit / 64] |= changed << (bit % 64);
+        if (bit % 64 > 56) {
+            bits[bit / 64 + 1] |= changed >> (64 - bit % 64);
+        }
+    }
+    dp_update_row<std::uint32_t>(row + i, source + i, count - i, value, bits, offset + i);
+}
+#endif
+
+// 0/1 knapsack over a rolling (max_weight + 1) x (max_volume + 1) table, where
+// cell (w, v) holds the best value within weight w and volume v. Rows are
+// walked from the top down so that every item reads cells it has not yet
+// written, and each row update is one contiguous pass (8 columns at a time
+// with AVX2).
+// The update flags are packed into one bitset per item to walk the choices
+// back from (max_weight, max_volume) afterwards.
+template<typename Value>
+void dp_solve(const Catalog & catalog, const Parameters & params,
+    const std::vector<std::uint32_t> & candidates, SelectionMask & selected)
+{
+    const auto & items = catalog.items;
+    const auto rows = static_cast<std::size_t>(params.max_weight) + 1;
+    const auto columns = static_cast<std::size_t>(params.max_volume) + 1;
+    const auto words = (columns + 63) / 64;
+
+    std::vector<Value> table(rows * columns, 0);
+    std::vector<Value> updated(columns);
+    std::vector<std::uint64_t> taken(candidates.size() * rows * words, 0);
+
+    for (std::size_t k = 0; k < candidates.size(); ++k) {
+        const auto & item = items[candidates[k]];
+        const auto weight = static_cast<std::size_t>(item.weight);
+        const auto volume = static_cast<std::size_t>(item.volume);
+        const auto value = static_cast<Value>(item.value);
+
+        for (std::size_t w = rows; w-- > weight;) {
+            Value * row = table.data() + w * columns;
+            // Reading from the item's own row (weight 0) must see the old
+            // values, so the source is copied out first in that case
+            const Value * source = table.data() + (w - weight) * columns;
+            if (weight == 0) {
+                std::copy(row, row + columns, updated.begin());
+                source = updated.data();
+            }
+            std::uint64_t * bits = taken.data() + (k * rows + w) * words;
+
+            dp_update_row(row + volume, source, columns - volume, value, bits, volume);
+        }
+    }
+
+    auto w = rows - 1;
+    auto v = columns - 1;
+    for (std::size_t k = candidates.size(); k-- > 0;) {
+        const std::uint64_t * bits = taken.data() + (k * rows + w) * words;
+        if ((bits[v / 64] >> (v % 64)) & 1) {
+            const auto & item = items[candidates[k]];
+            selected.set(candidates[k]);
+            w -= static_cast<std::size_t>(item.weight);
+            v -= static_cast<std::size_t>(item.volume);
+        }
+    }
+}
+
+// Exact answer to the capacity-only problem (e1 / e3): the most valuable
+// selection within max_weight and max_volume. Cost is O(items * cells) time
+// and items * cells bits, so check dp_applicable before reaching for it.
+inline SelectionMask knapsack_dp(const Catalog & catalog, const Parameters & params)
+{
+    std::vector<std::uint32_t> candidates;
+    std::vector<std::uint32_t> free;
+    capacity_candidates(catalog, params, candidates, free);
+
+    SelectionMask selected(catalog.items.size());
+    for (auto i : free) {
+        selected.set(i);
+    }
+
+    Amount total = 0;
+    for (auto i : candidates) {
+        total += catalog.items[i].value;
+    }
+    if (total <= std::numeric_limits<std::uint32_t>::max()) {
+        dp_solve<std::uint32_t>(catalog, params, candidates, selected);
+    } else {
+        dp_solve<Amount>(catalog, params, candidates, selected);
+    }
+    return selected;
+}
+
+#endif
@@ -0,0 +1,269 @@
+#ifndef CPSOLVER_COMMON_LOCAL_SEARCH_HPP
+#define CPSOLVER_COMMON_LOCAL_SEARCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "catalog.hpp"
+#include "constrained_greedy.hpp"
+#include "constraints.hpp"
+#include "order.hpp"
+#include "parameters.hpp"
+#include "portfolio.hpp"
+#include "selection_mask.hpp"
+#include "selection_state.hpp"
+
+struct LocalSearchStats {
+    Amount start_value = 0;
+    Amount final_value = 0;
+    std::size_t moves = 0;
+    std::size_t kicks = 0;
+};
+
+// Improves a valid selection until the deadline. Moves, tried in this order:
+//   add       an unselected item that still fits, densest first
+//   1-1 swap  a selected item for a more valuable unselected one
+//   2-1 swap  two selected items for one unselected item worth more than both
+// Every move raises the total, so whether it keeps the selection valid is
+// decided in O(1) from the running totals (see improving_swap_keeps_valid).
+// At a local optimum a few random items are dropped, kept out for one climb,
+// and the climb restarts; the best selection seen is what is returned. The
+// search stops at the deadline, after max_kicks kicks, or once max_idle_kicks
+// kicks in a row find nothing better, whichever comes first.
+//
+// An invalid start is repaired first. If that fails it is left untouched.
+class LocalSearch {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    LocalSearch(const Catalog & catalog, const Parameters & params, Clock::time_point deadline,
+        std::size_t max_kicks = std::numeric_limits<std::size_t>::max())
+        : catalog_(catalog), params_(params), deadline_(deadline), max_kicks_(max_kicks),
+        state_(catalog, params.max_weight, params.max_volume),
+        selected_(catalog.items.size()),
+        tabu_(catalog.items.size())
+    {
+    }
+
+    LocalSearchStats run(SelectionMask & selected)
+    {
+        restore(selected);
+        stats_.start_value = state_.value();
+        stats_.final_value = state_.value();
+
+        if (!satisfies(state_, params_)) {
+            repair(catalog_, params_, by_density(), state_, selected_);
+            if (!satisfies(state_, params_)) {
+                return stats_;
+            }
+        }
+
+        climb();
+        auto best = selected_;
+        auto best_value = state_.value();
+        std::size_t idle_kicks = 0;
+
+        while (!expired() && state_.count() > 0 && stats_.kicks < max_kicks_ && idle_kicks < max_idle_kicks) {
+            kick();
+            if (satisfies(state_, params_)) {
+                climb();
+            }
+
+            if (satisfies(state_, params_) && state_.value() > best_value) {
+                best = selected_;
+                best_value = state_.value();
+                idle_kicks = 0;
+            } else {
+                restore(best);
+                ++idle_kicks;
+            }
+        }
+
+        selected = std::move(best);
+        stats_.final_value = best_value;
+        return stats_;
+    }
+
+private:
+    // A kick drops up to a tenth of the selection, but at least this many items
+    static constexpr std::size_t min_kick = 3;
+    // Kicks in a row without a better selection before the search gives up
+    static constexpr std::size_t max_idle_kicks = 100;
+
+    bool expired() const { return Clock::now() >= deadline_; }
+
+    // The item orders are sorted on first use, so a search that runs out of
+    // time before it needs one does not pay for sorting the catalog
+    const Order & by_value()
+    {
+        if (by_value_.size() != catalog_.items.size()) {
+            by_value_ = sorted_order(catalog_.items.size(), [this](std::uint32_t a, std::uint32_t b) {
+                return catalog_.items[a].value > catalog_.items[b].value;
+            });
+        }
+        return by_value_;
+    }
+
+    const Order & by_density()
+    {
+        if (by_density_.size() != catalog_.items.size()) {
+            by_density_ = portfolio_order(catalog_, params_, 3);
+        }
+        return by_density_;
+    }
+
+    void restore(const SelectionMask & selected)
+    {
+        selected_ = selected;
+        state_.clear();
+        selected_.for_each([&](std::size_t i) {
+            state_.add(catalog_.items[i]);
+        });
+    }
+
+    // The selected indices, refilled into one buffer so moves do not allocate
+    const std::vector<std::uint32_t> & selected_list()
+    {
+        chosen_.clear();
+        selected_.for_each([&](std::size_t i) {
+            chosen_.push_back(static_cast<std::uint32_t>(i));
+        });
+        return chosen_;
+    }
+
+    bool available(std::uint32_t j) const { return !selected_.test(j) && !tabu_.test(j); }
+
+    void take(std::uint32_t j)
+    {
+        state_.add(catalog_.items[j]);
+        selected_.set(j);
+    }
+
+    void drop(std::uint32_t i)
+    {
+        state_.remove(catalog_.items[i]);
+        selected_.reset(i);
+    }
+
+    void climb()
+    {
+        while (!expired() && (try_add() || try_swap_one() || try_swap_two())) {
+            ++stats_.moves;
+        }
+        tabu_.clear();
+    }
+
+    bool try_add()
+    {
+        for (auto j : by_density()) {
+            if (available(j) && still_satisfies_with(state_, catalog_.items[j], params_)) {
+                take(j);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool try_swap_one()
+    {
+        const auto & items = catalog_.items;
+        const auto & order = by_value();
+        for (auto i : selected_list()) {
+            if (expired()) {
+                return false;
+            }
+            for (auto j : order) {
+                if (items[j].value <= items[i].value) {
+                    break;
+                }
+                if (available(j) && improving_swap_keeps_valid(state_, params_, items[j], items[i])) {
+                    drop(i);
+                    take(j);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool try_swap_two()
+    {
+        const auto & items = catalog_.items;
+        const auto & order = by_value();
+        const auto & chosen = selected_list();
+        for (std::size_t a = 0; a < chosen.size(); ++a) {
+            for (std::size_t b = a + 1; b < chosen.size(); ++b) {
+                // Pairs are quadratic in the selection, so the clock is read per pair
+                if (expired()) {
+                    return false;
+                }
+                const auto & out_a = items[chosen[a]];
+                const auto & out_b = items[chosen[b]];
+                for (auto j : order) {
+                    if (items[j].value <= out_a.value + out_b.value) {
+                        break;
+                    }
+                    if (available(j) && improving_swap_keeps_valid(state_, params_, items[j], out_a, &out_b)) {
+                        drop(chosen[a]);
+                        drop(chosen[b]);
+                        take(j);
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    void kick()
+    {
+        selected_list();
+        std::shuffle(chosen_.begin(), chosen_.end(), rng_);
+        auto limit = std::max(min_kick, chosen_.size() / 10);
+        auto count = std::min<std::size_t>(chosen_.size(), 1 + rng_() % limit);
+        for (std::size_t k = 0; k < count; ++k) {
+            drop(chosen_[k]);
+            tabu_.set(chosen_[k]);
+        }
+        ++stats_.kicks;
+    }
+
+    const Catalog & catalog_;
+    const Parameters & params_;
+    Clock::time_point deadline_;
+    std::size_t max_kicks_;
+    Order by_value_ = {};
+    Order by_density_ = {};
+    SelectionState state_;
+    SelectionMask selected_;
+    SelectionMask tabu_;
+    std::vector<std::uint32_t> chosen_ = {};
+    std::mt19937 rng_ = std::mt19937(1);
+    LocalSearchStats stats_ = {};
+};
+
+inline LocalSearchStats local_search(const Catalog & catalog, const Parameters & params,
+    SelectionMask & selected, std::chrono::milliseconds budget)
+{
+    LocalSearch search(catalog, params, LocalSearch::Clock::now() + budget);
+    return search.run(selected);
+}
+
+// Time a search bounded by kicks may still take. Each climb rescans the item
+// orders, so on catalogs of a million items a single kick costs over a second.
+constexpr std::chrono::milliseconds max_kick_search_time{1000};
+
+// The same search bounded by kicks instead of the clock, so that up to
+// max_kick_search_time its result does not depend on how fast the machine is
+inline LocalSearchStats local_search(const Catalog & catalog, const Parameters & params,
+    SelectionMask & selected, std::size_t max_kicks)
+{
+    LocalSearch search(catalog, params, LocalSearch::Clock::now() + max_kick_search_time, max_kicks);
+    return search.run(selected);
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef CPSOLVER_COMMON_MAPPED_FILE_HPP
+#define CPSOLVER_COMMON_MAPPED_FILE_HPP
+
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only private mapping of a whole file. An empty file maps to an empty view.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string & path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+        }
+
+        struct stat info = {};
+        if (::fstat(fd, &info) != 0) {
+            auto error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "cannot stat " + path);
+        }
+
+        size_ = static_cast<std::size_t>(info.st_size);
+        if (size_ > 0) {
+            data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data_ == MAP_FAILED) {
+                auto error = errno;
+                ::close(fd);
+                data_ = nullptr;
+                throw std::system_error(error, std::generic_category(), "cannot map " + path);
+            }
+            ::madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile && other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0))
+    {
+    }
+
+    MappedFile & operator=(MappedFile && other) noexcept
+    {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+
+    ~MappedFile()
+    {
+        if (data_ != nullptr) {
+            ::munmap(data_, size_);
+        }
+    }
+
+    std::string_view view() const { return {static_cast<const char *>(data_), size_}; }
+    const void * data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    void * data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef CPSOLVER_COMMON_OPTIONS_HPP
+#define CPSOLVER_COMMON_OPTIONS_HPP
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Command line switches of the form `--name` or `--name=value`. Anything that
+// does not start with `--` is kept as a positional argument (items path,
+// params path).
+class Options {
+public:
+    Options() = default;
+
+    Options(int argc, char * argv[])
+    {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg(argv[i]);
+            if (!arg.starts_with("--")) {
+                positional_.emplace_back(arg);
+                continue;
+            }
+
+            arg.remove_prefix(2);
+            auto eq = arg.find('=');
+            if (eq == std::string_view::npos) {
+                values_[std::string(arg)] = "";
+            } else {
+                values_[std::string(arg.substr(0, eq))] = std::string(arg.substr(eq + 1));
+            }
+        }
+    }
+
+    const std::vector<std::string> & positional() const { return positional_; }
+
+    bool has(const std::string & name) const { return values_.count(name) != 0; }
+
+    std::string get(const std::string & name, const std::string & fallback = "") const
+    {
+        auto it = values_.find(name);
+        return it == values_.end() ? fallback : it->second;
+    }
+
+    long get_long(const std::string & name, long fallback) const
+    {
+        auto it = values_.find(name);
+        return it == values_.end() || it->second.empty() ? fallback : std::stol(it->second);
+    }
+
+    double get_double(const std::string & name, double fallback) const
+    {
+        auto it = values_.find(name);
+        return it == values_.end() || it->second.empty() ? fallback : std::stod(it->second);
+    }
+
+private:
+    std::vector<std::string> positional_ = {};
+    std::map<std::string, std::string> values_ = {};
+};
+
+#endif
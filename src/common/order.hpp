@@ -0,0 +1,132 @@
+#ifndef CPSOLVER_COMMON_ORDER_HPP
+#define CPSOLVER_COMMON_ORDER_HPP
+
+#include <algorithm>
+#include <compare>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "catalog.hpp"
+#include "compact_items.hpp"
+
+// Sequence of catalog indices in the order a greedy pass should consider them
+using Order = std::vector<std::uint32_t>;
+
+inline Order identity_order(std::size_t size)
+{
+    Order order(size);
+    std::iota(order.begin(), order.end(), 0U);
+    return order;
+}
+
+// Catalog indices stably sorted by `before(index_a, index_b)`
+template<typename Compare>
+Order sorted_order(std::size_t size, Compare before)
+{
+    auto order = identity_order(size);
+    std::stable_sort(order.begin(), order.end(), before);
+    return order;
+}
+
+// Catalog indices in `before` order (ties by index, as sorted_order), sorted
+// a chunk at a time as a greedy pass consumes them. A pass that only looks at
+// the best few hundred items of a large catalog then costs one partition
+// rather than a full sort. Each chunk is twice the size of the last.
+//
+// next() also takes a `keep` predicate: before a new chunk is sorted, the
+// unsorted items failing it are dropped for good. That suits passes whose
+// remaining capacity only shrinks, where an item that does not fit now never
+// will, and lets them stop once nothing is left that could fit.
+template<typename Compare>
+class LazyOrder {
+public:
+    static constexpr std::size_t first_chunk = 256;
+
+    LazyOrder(std::size_t size, Compare before)
+        : indices_(identity_order(size)), end_(size), before_(before)
+    {
+    }
+
+    template<typename Keep>
+    bool next(std::uint32_t & index, Keep keep)
+    {
+        if (position_ == sorted_) {
+            widen(keep);
+        }
+        if (position_ == sorted_) {
+            return false;
+        }
+        index = indices_[position_++];
+        return true;
+    }
+
+private:
+    template<typename Keep>
+    void widen(Keep keep)
+    {
+        auto begin = indices_.begin() + static_cast<std::ptrdiff_t>(sorted_);
+        auto end = std::partition(begin, indices_.begin() + static_cast<std::ptrdiff_t>(end_), keep);
+        end_ = static_cast<std::size_t>(end - indices_.begin());
+
+        auto count = std::min(chunk_, end_ - sorted_);
+        auto before = [this](std::uint32_t a, std::uint32_t b) {
+            return before_(a, b) || (!before_(b, a) && a < b);
+        };
+        auto middle = begin + static_cast<std::ptrdiff_t>(count);
+        if (middle != end) {
+            std::nth_element(begin, middle, end, before);
+        }
+        std::sort(begin, middle, before);
+
+        sorted_ += count;
+        chunk_ *= 2;
+    }
+
+    Order indices_;
+    // indices_[0, sorted_) is in final order, [sorted_, end_) still unsorted
+    std::size_t sorted_ = 0;
+    std::size_t end_;
+    std::size_t position_ = 0;
+    std::size_t chunk_ = first_chunk;
+    Compare before_;
+};
+
+// Sort by value, weight, and volume. Takes Item or CompactItem.
+template<typename T>
+constexpr bool sort_by_filter(const T & a, const T & b) {
+    auto res = a.value <=> b.value;
+    if (res < 0) {
+        return false;
+    } else if (res > 0) {
+        return true;
+    }
+
+    res = a.weight <=> b.weight;
+    if (res < 0) {
+        return false;
+    } else if (res > 0) {
+        return true;
+    }
+
+    res = a.volume <=> b.volume;
+    if (res < 0) {
+        return false;
+    } else if (res > 0) {
+        return true;
+    }
+    return false;
+}
+
+// The whole catalog in sort_by_filter order, sorted over CompactItems when the
+// data fits them
+inline Order filter_order(const Catalog & catalog)
+{
+    return with_compact_items(catalog, [](const auto & items) {
+        return sorted_order(items.size(), [&items](std::uint32_t a, std::uint32_t b) {
+            return sort_by_filter(items[a], items[b]);
+        });
+    });
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef CPSOLVER_COMMON_PARALLEL_CATALOG_PARSER_HPP
+#define CPSOLVER_COMMON_PARALLEL_CATALOG_PARSER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "catalog.hpp"
+#include "catalog_binary.hpp"
+#include "catalog_parser.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+
+// Below this much text per thread, splitting costs more than it saves
+constexpr std::size_t parallel_parse_min_chunk = std::size_t{1} << 20;
+
+// Offset of the first item object at or after `from`: the `{` of a `}, {`
+// sequence. Returns npos if there is none before `to`. The match may lie
+// inside a string; parse_catalog_parallel checks every split it uses.
+inline std::size_t next_item_start(std::string_view text, std::size_t from, std::size_t to)
+{
+    auto is_space = [](char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; };
+    while (from < to) {
+        auto close = static_cast<const char *>(std::memchr(text.data() + from, '}', to - from));
+        if (close == nullptr) {
+            break;
+        }
+        auto at = static_cast<std::size_t>(close - text.data()) + 1;
+        while (at < text.size() && is_space(text[at])) {
+            ++at;
+        }
+        if (at < text.size() && text[at] == ',') {
+            ++at;
+            while (at < text.size() && is_space(text[at])) {
+                ++at;
+            }
+            if (at < text.size() && text[at] == '{') {
+                return at;
+            }
+        }
+        from = static_cast<std::size_t>(close - text.data()) + 1;
+    }
+    return std::string_view::npos;
+}
+
+// Parses the item array on all of `pool`'s threads. The text is cut into one
+// chunk per thread at item boundaries, each chunk is parsed into a Catalog of
+// its own, and the chunks are then merged: dictionaries first, in chunk order,
+// so ids come out exactly as a sequential parse assigns them, then the items,
+// in parallel, remapping their category ids.
+//
+// A cut is trusted only once the chunk before it has parsed right up to it,
+// which rules out cuts inside strings. If any chunk fails or a cut does not
+// line up, the whole text is parsed again sequentially, which also gives the
+// error message a sequential parse would.
+inline Catalog parse_catalog_parallel(std::string_view text, ThreadPool & pool)
+{
+    auto chunks = std::min(pool.size(), text.size() / parallel_parse_min_chunk);
+
+    // First item: the text after `[` and any space
+    std::size_t first = text.find_first_not_of(" \n\r\t");
+    if (chunks < 2 || first == std::string_view::npos || text[first] != '[') {
+        return parse_catalog(text);
+    }
+    first = text.find_first_not_of(" \n\r\t", first + 1);
+    if (first == std::string_view::npos || text[first] != '{') {
+        return parse_catalog(text);
+    }
+
+    std::vector<std::size_t> starts = {first};
+    for (std::size_t k = 1; k < chunks; ++k) {
+        auto from = std::max(text.size() / chunks * k, starts.back() + 1);
+        auto to = text.size() / chunks * (k + 1);
+        auto start = from < to ? next_item_start(text, from, to) : std::string_view::npos;
+        if (start != std::string_view::npos) {
+            starts.push_back(start);
+        }
+    }
+    starts.push_back(text.size());
+    chunks = starts.size() - 1;
+
+    std::vector<Catalog> parts(chunks);
+    std::vector<std::size_t> stops(chunks);
+    std::vector<char> failed(chunks, 0);
+    parallel_for(pool, chunks, [&](std::size_t k) {
+        try {
+            stops[k] = CatalogParser(text, parts[k]).parse_chunk(starts[k], starts[k + 1]);
+        } catch (const std::invalid_argument &) {
+            failed[k] = 1;
+        }
+    });
+
+    for (std::size_t k = 0; k < chunks; ++k) {
+        auto expected = k + 1 < chunks ? starts[k + 1] : std::string_view::npos;
+        if (failed[k] != 0 || stops[k] != expected) {
+            return parse_catalog(text);
+        }
+    }
+
+    Catalog catalog;
+    std::vector<std::vector<CategoryId>> manufacturer_ids(chunks);
+    std::vector<std::vector<CategoryId>> type_ids(chunks);
+    std::vector<std::size_t> offsets(chunks + 1, 0);
+    for (std::size_t k = 0; k < chunks; ++k) {
+        for (CategoryId id = 0; id < parts[k].manufacturers.size(); ++id) {
+            manufacturer_ids[k].push_back(catalog.manufacturers.intern(parts[k].manufacturers.name(id)));
+        }
+        for (CategoryId id = 0; id < parts[k].types.size(); ++id) {
+            type_ids[k].push_back(catalog.types.intern(parts[k].types.name(id)));
+        }
+        offsets[k + 1] = offsets[k] + parts[k].items.size();
+    }
+
+    catalog.items.resize(offsets.back());
+    parallel_for(pool, chunks, [&](std::size_t k) {
+        auto out = catalog.items.begin() + static_cast<std::ptrdiff_t>(offsets[k]);
+        for (const auto & item : parts[k].items) {
+            *out++ = {item.value, item.weight, item.volume, manufacturer_ids[k][item.manufacturer], type_ids[k][item.type]};
+        }
+        parts[k].items = {};
+    });
+    return catalog;
+}
+
+// map_catalog with the JSON parsed on `pool`
+inline Catalog map_catalog_parallel(const std::string & file_path, ThreadPool & pool)
+{
+    MappedFile file(file_path);
+    if (is_binary_catalog(file.view())) {
+        return BinaryCatalog(std::move(file)).to_catalog();
+    }
+    return parse_catalog_parallel(file.view(), pool);
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef CPSOLVER_COMMON_PARAMETERS_HPP
+#define CPSOLVER_COMMON_PARAMETERS_HPP
+
+#include "item.hpp"
+
+// Limits of one selection. The examples that only constrain weight and volume
+// leave the rest at their defaults, which never reject anything.
+struct Parameters {
+    Amount max_weight;
+    Amount max_volume;
+    Amount min_value = 0;
+    double high_value_max = 1.0;
+    double high_man_max = 1.0;
+    double high_type_max = 1.0;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef CPSOLVER_COMMON_PORTFOLIO_HPP
+#define CPSOLVER_COMMON_PORTFOLIO_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "catalog.hpp"
+#include "constraints.hpp"
+#include "order.hpp"
+#include "parameters.hpp"
+#include "selection_mask.hpp"
+#include "selection_state.hpp"
+#include "thread_pool.hpp"
+
+// Orders the portfolio tries, all best first:
+//   0. value, then weight, then volume (sort_by_filter)
+//   1. value / weight
+//   2. value / volume
+//   3. value / (weight / max_weight + volume / max_volume)
+// Entries past these cycle through the same four keys with ties broken in a
+// random order seeded by the entry's index instead of by catalog index.
+constexpr std::size_t portfolio_heuristics = 4;
+
+inline Order portfolio_order(const Catalog & catalog, const Parameters & params, std::size_t k)
+{
+    const auto & items = catalog.items;
+    const auto n = items.size();
+
+    std::vector<std::uint32_t> tie_rank;
+    if (k >= portfolio_heuristics) {
+        tie_rank = identity_order(n);
+        std::shuffle(tie_rank.begin(), tie_rank.end(), std::mt19937(static_cast<std::uint32_t>(k)));
+    }
+    auto tie_before = [&](std::uint32_t a, std::uint32_t b) {
+        return tie_rank.empty() ? a < b : tie_rank[a] < tie_rank[b];
+    };
+
+    if (k % portfolio_heuristics == 0) {
+        auto order = identity_order(n);
+        std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+            if (sort_by_filter(items[a], items[b])) {
+                return true;
+            }
+            return !sort_by_filter(items[b], items[a]) && tie_before(a, b);
+        });
+        return order;
+    }
+
+    // Keeps a zero denominator from turning 0 / 0 into NaN
+    constexpr double epsilon = 1e-9;
+    auto max_weight = static_cast<double>(std::max<Amount>(params.max_weight, 1));
+    auto max_volume = static_cast<double>(std::max<Amount>(params.max_volume, 1));
+
+    std::vector<double> key(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        auto value = static_cast<double>(items[i].value);
+        auto weight = static_cast<double>(items[i].weight);
+        auto volume = static_cast<double>(items[i].volume);
+        switch (k % portfolio_heuristics) {
+            case 1:
+                key[i] = value / std::max(weight, epsilon);
+                break;
+            case 2:
+                key[i] = value / std::max(volume, epsilon);
+                break;
+            default:
+                key[i] = value / std::max(weight / max_weight + volume / max_volume, epsilon);
+                break;
+        }
+    }
+
+    auto order = identity_order(n);
+    std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+        if (key[a] != key[b]) {
+            return key[a] > key[b];
+        }
+        return tie_before(a, b);
+    });
+    return order;
+}
+
+// Runs pass(catalog, params, order) for every portfolio order concurrently
+// on the pool and keeps the best valid selection: highest value, earliest
+// order on ties. If no order yields a valid selection the first order's
+// result is returned so the caller still has something to report.
+template<typename Pass>
+SelectionMask run_portfolio(const Catalog & catalog, const Parameters & params, Pass pass,
+    ThreadPool & pool, std::size_t random_orders)
+{
+    const auto count = portfolio_heuristics + random_orders;
+
+    std::vector<SelectionMask> results(count);
+    std::vector<Amount> values(count, 0);
+    std::vector<char> valid(count, 0);
+
+    parallel_for(pool, count, [&](std::size_t k) {
+        results[k] = pass(catalog, params, portfolio_order(catalog, params, k));
+
+        SelectionState state(catalog, params.max_weight, params.max_volume);
+        results[k].for_each([&](std::size_t i) {
+            state.add(catalog.items[i]);
+        });
+        valid[k] = satisfies(state, params);
+        values[k] = state.value();
+    });
+
+    std::size_t best = 0;
+    for (std::size_t k = 1; k < count; ++k) {
+        if (valid[k] && (!valid[best] || values[k] > values[best])) {
+            best = k;
+        }
+    }
+    return std::move(results[best]);
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef CPSOLVER_COMMON_RATIO_HPP
+#define CPSOLVER_COMMON_RATIO_HPP
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// A share limit as an exact fraction, for integer models: share / total <= limit
+// becomes denominator * share <= numerator * total
+struct Ratio {
+    std::int64_t numerator;
+    std::int64_t denominator;
+};
+
+// Throws unless `limit` is a finite number in [0, max_limit]. Finiteness is
+// read off the exponent bits, since under -Ofast the compiler may assume
+// std::isfinite holds and drop the test. `name` goes into the message.
+inline void check_share_limit(const std::string & name, double limit, double max_limit = 1000000)
+{
+    constexpr std::uint64_t exponent = 0x7FF0000000000000;
+    if ((std::bit_cast<std::uint64_t>(limit) & exponent) == exponent || limit < 0 || limit > max_limit) {
+        throw std::invalid_argument(name + " out of range");
+    }
+}
+
+// The first continued-fraction convergent of `limit` that is within rounding
+// of it, so the 0.7 read from JSON becomes 7 / 10 rather than the
+// 3152519739159347 / 2^52 the double holds. The denominator stays at or
+// below max_denominator; if that cuts the expansion short, the result is the
+// closest fraction below `limit` with such a denominator, so the constraint
+// is never looser than asked for.
+inline Ratio to_ratio(double limit, std::int64_t max_denominator = 1000000)
+{
+    check_share_limit("share limit", limit, static_cast<double>(max_denominator));
+
+    // Convergents h / k, with the two before them
+    std::int64_t h = 1, h_prev = 0;
+    std::int64_t k = 0, k_prev = 1;
+    double x = limit;
+    while (true) {
+        auto a = static_cast<std::int64_t>(std::floor(x));
+        auto h_next = a * h + h_prev;
+        auto k_next = a * k + k_prev;
+        if (k_next > max_denominator) {
+            // Convergents alternate around limit. Below it, h / k is the best
+            // bound already; above it, the best lies between h_prev / k_prev
+            // and h / k, at the largest semiconvergent denominator allowed.
+            if (static_cast<double>(h) / static_cast<double>(k) > limit) {
+                auto j = (max_denominator - k_prev) / k;
+                return {h_prev + j * h, k_prev + j * k};
+            }
+            break;
+        }
+        h_prev = h;
+        k_prev = k;
+        h = h_next;
+        k = k_next;
+
+        auto fraction = x - static_cast<double>(a);
+        if (std::abs(static_cast<double>(h) / static_cast<double>(k) - limit) <= limit * 1e-15 || fraction < 1e-12) {
+            break;
+        }
+        x = 1 / fraction;
+    }
+    return {h, k};
+}
+
+#endif
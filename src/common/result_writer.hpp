@@ -0,0 +1,222 @@
+#ifndef CPSOLVER_COMMON_RESULT_WRITER_HPP
+#define CPSOLVER_COMMON_RESULT_WRITER_HPP
+
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Output of a run assembled in one buffer and written out with as few write
+// calls as the kernel allows. Plain text goes in with <<, formatted as an
+// ostream with default flags would; JSON is written element by element,
+// pretty (laid out as nlohmann's dump(4)) or compact (as dump()), so no DOM
+// is built. Keys are written in the order given.
+class ResultWriter {
+public:
+    explicit ResultWriter(bool pretty = true) : pretty_(pretty) {}
+
+    void reserve(std::size_t bytes) { buffer_.reserve(bytes); }
+
+    ResultWriter & operator<<(std::string_view text)
+    {
+        buffer_ += text;
+        return *this;
+    }
+
+    ResultWriter & operator<<(const char * text) { return *this << std::string_view(text); }
+
+    ResultWriter & operator<<(char c)
+    {
+        buffer_ += c;
+        return *this;
+    }
+
+    template<std::integral T>
+    ResultWriter & operator<<(T number)
+    {
+        char digits[24];
+        auto end = std::to_chars(digits, digits + sizeof(digits), number).ptr;
+        buffer_.append(digits, end);
+        return *this;
+    }
+
+    // %g with six significant digits, the ostream default
+    ResultWriter & operator<<(double number)
+    {
+        char digits[32];
+        auto end = std::to_chars(digits, digits + sizeof(digits), number, std::chars_format::general, 6).ptr;
+        buffer_.append(digits, end);
+        return *this;
+    }
+
+    void begin_array() { open('['); }
+    void end_array() { close(']'); }
+    void begin_object() { open('{'); }
+    void end_object() { close('}'); }
+
+    void key(std::string_view name)
+    {
+        element();
+        quote(name);
+        buffer_ += pretty_ ? ": " : ":";
+        after_key_ = true;
+    }
+
+    template<std::integral T>
+    void value(T number)
+    {
+        element();
+        *this << number;
+    }
+
+    void value(bool flag)
+    {
+        element();
+        buffer_ += flag ? "true" : "false";
+    }
+
+    // Shortest text that reads back as `number`, with ".0" on whole numbers
+    // and null for NaN and infinities, as nlohmann writes them
+    void value(double number)
+    {
+        element();
+        if (!std::isfinite(number)) {
+            buffer_ += "null";
+            return;
+        }
+        char digits[32];
+        auto end = std::to_chars(digits, digits + sizeof(digits), number).ptr;
+        std::string_view text(digits, static_cast<std::size_t>(end - digits));
+        buffer_ += text;
+        if (text.find_first_of(".e") == std::string_view::npos) {
+            buffer_ += ".0";
+        }
+    }
+
+    void value(std::string_view text)
+    {
+        element();
+        quote(text);
+    }
+
+    const std::string & str() const { return buffer_; }
+
+    // Writes the buffer to `file_path`, or to stdout if it is empty
+    void write(const std::string & file_path = "") const
+    {
+        int fd = STDOUT_FILENO;
+        if (!file_path.empty()) {
+            fd = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "cannot open " + file_path);
+            }
+        }
+
+        const char * data = buffer_.data();
+        std::size_t left = buffer_.size();
+        while (left > 0) {
+            auto written = ::write(fd, data, left);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written < 0) {
+                auto error = errno;
+                if (fd != STDOUT_FILENO) {
+                    ::close(fd);
+                }
+                throw std::system_error(error, std::generic_category(), "cannot write results");
+            }
+            data += written;
+            left -= static_cast<std::size_t>(written);
+        }
+        if (fd != STDOUT_FILENO) {
+            ::close(fd);
+        }
+    }
+
+private:
+    static constexpr std::size_t indent = 4;
+
+    // Comma and line break before an array element or object key
+    void element()
+    {
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+        if (counts_.empty()) {
+            return;
+        }
+        if (counts_.back()++ > 0) {
+            buffer_ += ',';
+        }
+        newline();
+    }
+
+    void newline()
+    {
+        if (pretty_) {
+            buffer_ += '\n';
+            buffer_.append(counts_.size() * indent, ' ');
+        }
+    }
+
+    void open(char bracket)
+    {
+        element();
+        buffer_ += bracket;
+        counts_.push_back(0);
+    }
+
+    void close(char bracket)
+    {
+        auto count = counts_.back();
+        counts_.pop_back();
+        if (count > 0) {
+            newline();
+        }
+        buffer_ += bracket;
+    }
+
+    void quote(std::string_view text)
+    {
+        static constexpr char hex[] = "0123456789abcdef";
+        buffer_ += '"';
+        for (auto c : text) {
+            switch (c) {
+                case '"': buffer_ += "\\\""; break;
+                case '\\': buffer_ += "\\\\"; break;
+                case '\b': buffer_ += "\\b"; break;
+                case '\f': buffer_ += "\\f"; break;
+                case '\n': buffer_ += "\\n"; break;
+                case '\r': buffer_ += "\\r"; break;
+                case '\t': buffer_ += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        buffer_ += "\\u00";
+                        buffer_ += hex[static_cast<unsigned char>(c) >> 4];
+                        buffer_ += hex[static_cast<unsigned char>(c) & 0xF];
+                    } else {
+                        buffer_ += c;
+                    }
+            }
+        }
+        buffer_ += '"';
+    }
+
+    bool pretty_;
+    bool after_key_ = false;
+    // Elements written so far in each open array or object
+    std::vector<std::size_t> counts_ = {};
+    std::string buffer_ = {};
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef CPSOLVER_COMMON_SELECTION_MASK_HPP
+#define CPSOLVER_COMMON_SELECTION_MASK_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+// One bit per catalog item, set when the item is selected
+class SelectionMask {
+public:
+    SelectionMask() = default;
+
+    explicit SelectionMask(std::size_t size)
+        : words_((size + 63) / 64, 0), size_(size)
+    {
+    }
+
+    void set(std::size_t i) { words_[i / 64] |= bit(i); }
+    void reset(std::size_t i) { words_[i / 64] &= ~bit(i); }
+    bool test(std::size_t i) const { return (words_[i / 64] & bit(i)) != 0; }
+
+    // Unsets every bit, keeping the storage
+    void clear() { std::fill(words_.begin(), words_.end(), 0); }
+
+    std::size_t size() const { return size_; }
+
+    std::size_t count() const
+    {
+        std::size_t total = 0;
+        for (auto word : words_) {
+            total += static_cast<std::size_t>(std::popcount(word));
+        }
+        return total;
+    }
+
+    bool any() const
+    {
+        for (auto word : words_) {
+            if (word != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::vector<std::uint64_t> & words() const { return words_; }
+
+    // Calls f(index) for every selected item in ascending index order
+    template<typename F>
+    void for_each(F f) const
+    {
+        for (std::size_t w = 0; w < words_.size(); ++w) {
+            for (auto word = words_[w]; word != 0; word &= word - 1) {
+                f(w * 64 + static_cast<std::size_t>(std::countr_zero(word)));
+            }
+        }
+    }
+
+private:
+    static constexpr std::uint64_t bit(std::size_t i) { return std::uint64_t{1} << (i % 64); }
+
+    std::vector<std::uint64_t> words_ = {};
+    std::size_t size_ = 0;
+};
+
+#endif
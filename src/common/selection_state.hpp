@@ -0,0 +1,200 @@
+#ifndef CPSOLVER_COMMON_SELECTION_STATE_HPP
+#define CPSOLVER_COMMON_SELECTION_STATE_HPP
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "catalog.hpp"
+
+// Running totals of a selection. Adding, removing and asking whether an item
+// still fits are all O(1), so a greedy pass never has to re-sum what it has
+// already selected. So that the largest selected value survives removals,
+// selected items are also counted per value, in a hash table that stops
+// allocating once every value in play has been seen; the largest value is
+// recomputed from it only when its last item is removed.
+// Items may be Item or CompactItem; totals are kept as Amount either way.
+class SelectionState {
+public:
+    SelectionState(const Catalog & catalog, Amount max_weight, Amount max_volume)
+        : max_weight_(max_weight), max_volume_(max_volume),
+        manufacturer_values_(catalog.manufacturers.size(), 0),
+        type_values_(catalog.types.size(), 0)
+    {
+    }
+
+    template<typename T>
+    bool can_add(const T & item) const
+    {
+        return weight_ + item.weight <= max_weight_ &&
+            volume_ + item.volume <= max_volume_;
+    }
+
+    template<typename T>
+    void add(const T & item)
+    {
+        value_ += item.value;
+        weight_ += item.weight;
+        volume_ += item.volume;
+        manufacturer_values_[item.manufacturer] += item.value;
+        type_values_[item.type] += item.value;
+        ++count_of(item.value);
+        if (!max_stale_ && item.value > max_value_) {
+            max_value_ = item.value;
+        }
+        ++count_;
+    }
+
+    template<typename T>
+    void remove(const T & item)
+    {
+        value_ -= item.value;
+        weight_ -= item.weight;
+        volume_ -= item.volume;
+        manufacturer_values_[item.manufacturer] -= item.value;
+        type_values_[item.type] -= item.value;
+        if (--count_of(item.value) == 0 && item.value == max_value_) {
+            max_stale_ = true;
+        }
+        --count_;
+    }
+
+    // Back to an empty selection, keeping the per-category storage
+    void clear()
+    {
+        value_ = weight_ = volume_ = 0;
+        count_ = 0;
+        std::fill(manufacturer_values_.begin(), manufacturer_values_.end(), 0);
+        std::fill(type_values_.begin(), type_values_.end(), 0);
+        for (auto & slot : value_counts_) {
+            slot.count = 0;
+        }
+        max_value_ = 0;
+        max_stale_ = false;
+    }
+
+    bool over_capacity() const
+    {
+        return weight_ > max_weight_ || volume_ > max_volume_;
+    }
+
+    Amount remaining_weight() const { return max_weight_ - weight_; }
+    Amount remaining_volume() const { return max_volume_ - volume_; }
+
+    Amount value() const { return value_; }
+    Amount weight() const { return weight_; }
+    Amount volume() const { return volume_; }
+    std::size_t count() const { return count_; }
+
+    // Largest value among the selected items, 0 when nothing is selected
+    Amount max_value() const
+    {
+        if (max_stale_) {
+            max_value_ = largest_value_below(std::numeric_limits<Amount>::max(), true);
+            max_stale_ = false;
+        }
+        return max_value_;
+    }
+
+    // Largest selected value if one item of value `removed` were taken out
+    Amount max_value_without(Amount removed) const
+    {
+        auto largest = max_value();
+        if (largest != removed || find_count(largest) > 1) {
+            return largest;
+        }
+        return largest_value_below(largest, false);
+    }
+
+    // Value selected per manufacturer / product type, indexed by CategoryId
+    const std::vector<Amount> & manufacturer_values() const { return manufacturer_values_; }
+    const std::vector<Amount> & type_values() const { return type_values_; }
+
+private:
+    Amount max_weight_;
+    Amount max_volume_;
+    Amount value_ = 0;
+    Amount weight_ = 0;
+    Amount volume_ = 0;
+    std::size_t count_ = 0;
+    std::vector<Amount> manufacturer_values_;
+    std::vector<Amount> type_values_;
+    struct ValueCount {
+        Amount value;
+        std::size_t count;
+        bool used;
+    };
+
+    static std::size_t slot_hash(Amount value)
+    {
+        value *= 0x9E3779B97F4A7C15ULL;
+        return static_cast<std::size_t>(value ^ (value >> 32));
+    }
+
+    // Linear probing over a power-of-two table. Entries are never removed,
+    // only counted down to zero, so a probe never meets a hole it should
+    // have skipped.
+    std::size_t & count_of(Amount value)
+    {
+        if ((values_seen_ + 1) * 2 > value_counts_.size()) {
+            grow();
+        }
+        auto mask = value_counts_.size() - 1;
+        for (auto at = slot_hash(value) & mask;; at = (at + 1) & mask) {
+            auto & slot = value_counts_[at];
+            if (!slot.used) {
+                slot = {value, 0, true};
+                ++values_seen_;
+                return slot.count;
+            }
+            if (slot.value == value) {
+                return slot.count;
+            }
+        }
+    }
+
+    std::size_t find_count(Amount value) const
+    {
+        if (value_counts_.empty()) {
+            return 0;
+        }
+        auto mask = value_counts_.size() - 1;
+        for (auto at = slot_hash(value) & mask; value_counts_[at].used; at = (at + 1) & mask) {
+            if (value_counts_[at].value == value) {
+                return value_counts_[at].count;
+            }
+        }
+        return 0;
+    }
+
+    // Largest selected value under `bound` (or equal to it, if `inclusive`), 0 if none
+    Amount largest_value_below(Amount bound, bool inclusive) const
+    {
+        Amount largest = 0;
+        for (const auto & slot : value_counts_) {
+            if (slot.count > 0 && (slot.value < bound || (inclusive && slot.value == bound))) {
+                largest = std::max(largest, slot.value);
+            }
+        }
+        return largest;
+    }
+
+    void grow()
+    {
+        std::vector<ValueCount> old(std::max<std::size_t>(16, value_counts_.size() * 2), ValueCount{0, 0, false});
+        old.swap(value_counts_);
+        values_seen_ = 0;
+        for (const auto & slot : old) {
+            if (slot.used) {
+                count_of(slot.value) = slot.count;
+            }
+        }
+    }
+
+    std::vector<ValueCount> value_counts_ = {};
+    std::size_t values_seen_ = 0;
+    mutable Amount max_value_ = 0;
+    mutable bool max_stale_ = false;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef CPSOLVER_COMMON_SOLUTION_LOG_HPP
+#define CPSOLVER_COMMON_SOLUTION_LOG_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "result_writer.hpp"
+
+// Progress of an anytime solve: one JSON line per improving solution, with
+// the seconds since the solve started, its objective, the solver's bound at
+// that moment and the number of items selected. Lines are flushed as they are
+// written, so a reader sees each one at once and whatever it last saw is the
+// best answer so far. Solutions no better than the last one logged are
+// skipped.
+class SolutionLog {
+public:
+    // Writes to `file_path`, or to stdout if it is empty
+    explicit SolutionLog(const std::string & file_path)
+    {
+        if (!file_path.empty()) {
+            file_.open(file_path, std::ios::trunc);
+            if (!file_) {
+                throw std::invalid_argument("cannot open " + file_path);
+            }
+        }
+    }
+
+    void record(double seconds, double objective, double bound, std::size_t items)
+    {
+        if (objective <= best_) {
+            return;
+        }
+        best_ = objective;
+
+        ResultWriter line(false);
+        line.begin_object();
+        line.key("time");
+        line.value(seconds);
+        line.key("objective");
+        line.value(objective);
+        line.key("bound");
+        line.value(bound);
+        line.key("items");
+        line.value(items);
+        line.end_object();
+
+        auto & out = file_.is_open() ? static_cast<std::ostream &>(file_) : std::cout;
+        out << line.str() << '\n' << std::flush;
+    }
+
+private:
+    std::ofstream file_ = {};
+    double best_ = -std::numeric_limits<double>::infinity();
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef CPSOLVER_COMMON_TERMINATION_HPP
+#define CPSOLVER_COMMON_TERMINATION_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "options.hpp"
+
+// When an exact solver may stop short of proving optimality. Zero gaps and a
+// zero stall leave the solver's own behaviour alone.
+struct Termination {
+    // Stop once (bound - objective) / bound, or bound - objective, is this small
+    double relative_gap = 0;
+    double absolute_gap = 0;
+    // Stop after this many seconds without an improving solution
+    double stall_seconds = 0;
+    // Seconds the solve may take
+    double time_limit = 3 * 60;
+};
+
+// Reads --gap, --abs-gap, --stall and --deadline. The deadline is seconds
+// for the whole run, counted from `started`, so whatever loading and the
+// core reduction took comes out of the solver's time limit.
+inline Termination read_termination(const Options & options, std::chrono::steady_clock::time_point started)
+{
+    Termination termination;
+    termination.relative_gap = options.get_double("gap", 0);
+    termination.absolute_gap = options.get_double("abs-gap", 0);
+    termination.stall_seconds = options.get_double("stall", 0);
+    if (options.has("deadline")) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        termination.time_limit = std::max(0.0, options.get_double("deadline", 0) - elapsed.count());
+    }
+    return termination;
+}
+
+// Why a solve ended. `finished` is the solver's own verdict (optimal, which
+// includes stopping within a gap limit); comparing objective and bound tells
+// the two apart. Every objective here is a sum of integer values, so a bound
+// less than one above the objective proves it.
+inline std::string stop_reason(bool finished, bool infeasible, bool stalled, double objective, double bound)
+{
+    if (infeasible) {
+        return "infeasible";
+    }
+    if (finished) {
+        return std::floor(bound + 1e-6) <= objective + 1e-6 ? "optimal" : "gap";
+    }
+    return stalled ? "stall" : "time limit";
+}
+
+// Calls stop() once `seconds` pass without a call to improved(), on a thread
+// of its own, for solvers that can be interrupted but have no stall limit.
+// Does nothing for a zero limit.
+class StallWatch {
+public:
+    StallWatch(double seconds, std::function<void()> stop) : stop_(std::move(stop))
+    {
+        if (seconds <= 0) {
+            return;
+        }
+        auto limit = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+        last_ = std::chrono::steady_clock::now();
+        thread_ = std::thread([this, limit] {
+            std::unique_lock lock(mutex_);
+            while (!done_) {
+                if (wake_.wait_until(lock, last_ + limit) == std::cv_status::timeout && !done_ &&
+                    std::chrono::steady_clock::now() >= last_ + limit) {
+                    fired_ = true;
+                    stop_();
+                    return;
+                }
+            }
+        });
+    }
+
+    StallWatch(const StallWatch &) = delete;
+    StallWatch & operator=(const StallWatch &) = delete;
+
+    ~StallWatch() { finish(); }
+
+    void improved()
+    {
+        std::lock_guard lock(mutex_);
+        last_ = std::chrono::steady_clock::now();
+    }
+
+    // Stops watching; call once the solve has returned
+    void finish()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            done_ = true;
+        }
+        wake_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    bool fired() const
+    {
+        std::lock_guard lock(mutex_);
+        return fired_;
+    }
+
+private:
+    std::function<void()> stop_;
+    mutable std::mutex mutex_ = {};
+    std::condition_variable wake_ = {};
+    std::chrono::steady_clock::time_point last_ = {};
+    bool done_ = false;
+    bool fired_ = false;
+    std::thread thread_ = {};
+};
+
+#endif
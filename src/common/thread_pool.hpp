@@ -0,0 +1,118 @@
+#ifndef CPSOLVER_COMMON_THREAD_POOL_HPP
+#define CPSOLVER_COMMON_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads fed from one queue. wait() blocks until every
+// submitted task has finished and rethrows the first exception a task threw.
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t threads = default_size())
+    {
+        threads = std::max<std::size_t>(threads, 1);
+        workers_.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this] { work(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto & worker : workers_) {
+            worker.join();
+        }
+    }
+
+    static std::size_t default_size() { return std::max(std::thread::hardware_concurrency(), 1U); }
+
+    std::size_t size() const { return workers_.size(); }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard lock(mutex_);
+            tasks_.push_back(std::move(task));
+            ++pending_;
+        }
+        wake_.notify_one();
+    }
+
+    void wait()
+    {
+        std::unique_lock lock(mutex_);
+        done_.wait(lock, [this] { return pending_ == 0; });
+        if (error_) {
+            auto error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    void work()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex_);
+                wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+
+            std::exception_ptr error;
+            try {
+                task();
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            std::lock_guard lock(mutex_);
+            if (error && !error_) {
+                error_ = error;
+            }
+            if (--pending_ == 0) {
+                done_.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers_ = {};
+    std::deque<std::function<void()>> tasks_ = {};
+    std::mutex mutex_ = {};
+    std::condition_variable wake_ = {};
+    std::condition_variable done_ = {};
+    std::size_t pending_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_ = nullptr;
+};
+
+// Runs f(i) for every i in [0, count) on the pool and waits for all of them
+template<typename F>
+void parallel_for(ThreadPool & pool, std::size_t count, F f)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        pool.submit([&f, i] { f(i); });
+    }
+    pool.wait();
+}
+
+#endif
@@ -0,0 +1,39 @@
+
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <exception>
+
+#include "catalog.hpp"
+#include "catalog_binary.hpp"
+#include "catalog_parser.hpp"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// Usage: catalog_convert items.json items.cpcat
+//
+// Writes the items file in the binary columnar format of catalog_binary.hpp.
+// Every example accepts the result in place of the JSON items file.
+int main(int argc, char * argv[]) {
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " items.json items.cpcat" << endl;
+        return 1;
+    }
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        auto catalog = map_catalog(argv[1]);
+        write_binary_catalog(catalog, argv[2]);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+        cout << "Wrote " << catalog.items.size() << " items (" << catalog.manufacturers.size() << " manufacturers, "
+            << catalog.types.size() << " product types) to " << argv[2] << " in " << elapsed.count() << " ms" << endl;
+    } catch (const std::exception & e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
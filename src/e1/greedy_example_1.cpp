@@ -4,124 +4,94 @@
 #include <cstdint>
 #include <iostream>
 #include <algorithm>
-#include <compare>
 #include <fstream>
-
-#include <numeric>
+#include <chrono>
+#include <stdexcept>
+#include <ostream>
+#include <sstream>
 
 #include "json.hpp"
 
-using Amount = std::uint64_t;
+#include "item.hpp"
+#include "catalog.hpp"
+#include "catalog_loader.hpp"
+#include "catalog_stream.hpp"
+#include "parameters.hpp"
+#include "options.hpp"
+#include "selection_state.hpp"
+#include "capacity_greedy.hpp"
+#include "selection_mask.hpp"
+#include "item_table.hpp"
+#include "order.hpp"
+#include "compact_items.hpp"
+#include "thread_pool.hpp"
+#include "portfolio.hpp"
+#include "local_search.hpp"
+#include "knapsack_dp.hpp"
+#include "branch_and_bound.hpp"
+#include "core_reduction.hpp"
+#include "batch.hpp"
+#include "result_writer.hpp"
+#include "allocation_counter.hpp"
 
 using std::string;
 using std::vector;
 using std::cout;
 using std::endl;
-using std::sort;
 using std::pair;
-using std::accumulate;
-
-struct Item {
-  Amount value;
-  Amount weight;
-  Amount volume;
-  string manufacturer;
-  string type;
-};
-
-using Group = vector<Item>;
-
-struct Parameters {
-  Amount max_weight;
-  Amount max_volume;
-};
-
-constexpr Amount sum_value(const Group & selected) {
-  return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-    [](const Amount & a, const Item & b) {
-      return a + b.value;
-    }
-  );
-}
 
-constexpr Amount sum_weight(const Group & selected) {
-  return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-    [](const Amount & a, const Item & b) {
-      return a + b.weight;
-    }
-  );
-}
-
-constexpr bool above_weight(const Item & item, const Group & selected, const Amount & max_weight)
-{
-  return sum_weight(selected) + item.weight > max_weight;
-}
-
-constexpr Amount sum_volume(const Group & selected) {
-   return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-    [](const Amount & a, const Item & b) {
-      return a + b.volume;
-    }
-  );
-}
-
-constexpr bool above_volume(const Item & item, const Group & selected, const Amount & max_volume)
-{
-  return sum_volume(selected) + item.volume > max_volume;
+SelectionMask find_grouping(const Catalog & catalog, const Parameters & params, const Order & order) {
+  return capacity_greedy(catalog, params, order);
 }
 
-Group find_grouping(const vector<Item> & items, const Parameters & params) {
-  
-  Group selected;
-  for(auto item : items)
-  {
-    if (above_weight(item, selected, params.max_weight) ||
-        above_volume(item, selected, params.max_volume))
-    {
-      continue;
-    }
-
-    selected.push_back(item);
+// `to_beat` is the value of a known selection; bb then only looks for better ones
+SelectionMask find_exact(const Catalog & catalog, const Parameters & params, Amount to_beat, const string & engine,
+  const Options & options, std::ostream & log) {
+  if (engine == "dp") {
+    return knapsack_dp(catalog, params);
   }
-  return selected;
-}
 
-template<typename V>
-void to_json(nlohmann::json & j, const vector<V> & p)
-{
-  for (auto & item: p)
-  {
-  nlohmann::json inner;
-  to_json(inner, item);
-  j.push_back(inner);
+  auto node_limit = static_cast<std::size_t>(options.get_long("node-limit", static_cast<long>(default_node_limit)));
+  auto result = branch_and_bound(catalog, params, node_limit, to_beat);
+  if (!result.optimal) {
+    log << "Branch and bound hit the node limit after " << result.nodes << " nodes; best selection found, not proven optimal:" << endl;
   }
+  return std::move(result.selected);
 }
 
-void to_json(nlohmann::json & j, const Item & i)
+// Keys in alphabetical order, as nlohmann::json used to write them
+void write_item(ResultWriter & out, const Item & i)
 {
-  j["value"] = i.value;
-  j["weight"] = i.weight;
-  j["volume"] = i.volume;
+  out.begin_object();
+  out.key("value");
+  out.value(i.value);
+  out.key("volume");
+  out.value(i.volume);
+  out.key("weight");
+  out.value(i.weight);
+  out.end_object();
 }
 
-template<typename V>
-void from_json(const nlohmann::json& j, vector<V> & p)
+void write_chosen(ResultWriter & out, const SelectionMask & p, const Catalog & catalog, bool indices)
 {
-  
-  for (auto & inner: j)
-  {
-    V item;
-    from_json(inner, item);
-    p.push_back(item);
+  // Listed best first, the order the greedy considers them in
+  Order chosen;
+  p.for_each([&](std::size_t i) {
+    chosen.push_back(static_cast<std::uint32_t>(i));
+  });
+  std::stable_sort(chosen.begin(), chosen.end(), [&catalog](std::uint32_t a, std::uint32_t b) {
+    return sort_by_filter(catalog.items[a], catalog.items[b]);
+  });
+
+  out.begin_array();
+  for (auto i : chosen) {
+    if (indices) {
+      out.value(i);
+    } else {
+      write_item(out, catalog.items[i]);
+    }
   }
-}
-
-void from_json(const nlohmann::json& j, Item& p) {
-    j.at("value").get_to(p.value);
-    j.at("weight").get_to(p.weight);
-    j.at("volume").get_to(p.volume);
-    j.at("product_type").get_to(p.type);
-    j.at("manufacturer").get_to(p.manufacturer);
+  out.end_array();
 }
 
 void from_json(const nlohmann::json& j, Parameters& p) {
@@ -141,76 +111,182 @@ V read_json(const std::string & file_path)
     return data;
 }
 
-constexpr pair<Parameters, bool> check_valid(const Group & selected, const Parameters & params)
+pair<Parameters, bool> check_valid(const ItemTable & table, const SelectionMask & selected, const Parameters & params)
 {
-  auto total_weight = sum_weight(selected);
-  auto total_volume = sum_volume(selected);
+  auto total_weight = table.sum_weight(selected);
+  auto total_volume = table.sum_volume(selected);
   return {{total_weight, total_volume}, total_weight > params.max_weight || total_volume > params.max_volume};
 }
 
-// Sort by value, weight, and volume
-constexpr bool sort_by_filter(const Item & a, const Item & b) {
-  auto res = a.value <=> b.value;
-  if (res < 0) {
-    return false;
-  } else if (res > 0) {
-    return true;
-  }
-
-  res = a.weight <=> b.weight;
-  if (res < 0) {
-    return false;
-  } else if (res > 0) {
-    return true;
-  }
+void print_results(const Catalog & catalog, const ItemTable & table, const SelectionMask & chosen, const Parameters & params,
+  const Options & options)
+{
+  auto [val_params, invalid] = check_valid(table, chosen, params);
+
+  ResultWriter out(!options.has("compact"));
+  out << (invalid ? "Invalid" : "Valid") << " Parameters\n";
+  out << "Value: " << table.sum_value(chosen) << '\n';
+  out << "Weight: " << val_params.max_weight << '\n';
+  out << "Volume: " << val_params.max_volume << '\n';
+  out << '\n';
+  out << "Chosen:\n";
+  write_chosen(out, chosen, catalog, options.has("indices"));
+  out << '\n';
+
+  cout.flush();
+  out.write(options.get("output"));
+}
 
-  res = a.volume <=> b.volume;
-  if (res < 0) {
-    return false;
-  } else if (res > 0) {
-    return true;
-  }
-  return false;
+// Usage: greedy_example_1 [items.json params.json] [options]
+//        greedy_example_1 items.json scenarios.json --batch [options]
+//   --loader=L              mmap (default; maps the items file and parses it in place), parallel (the same,
+//                           parsed in chunks on --threads threads) or sax; the mmap loaders also read
+//                           binary catalogs written by catalog_convert
+//   --stream                read items.json as NDJSON, one item per line ("-" for stdin), keeping only
+//                           the items an optimal selection can use, so memory does not grow with the input
+//   --engine=E              greedy, dp (exact, small capacities only), bb (branch and bound, exact only
+//                           if it finishes within --node-limit, otherwise a heuristic that improves on
+//                           the greedy incumbent) or auto (default): dp when max_weight x max_volume fits
+//                           dp_max_cells and its bitset for the core's items fits dp_max_taken_bytes,
+//                           bb otherwise
+//   --node-limit=N          nodes bb explores before settling for its best selection so far (default: 1000000)
+//   --no-core               hand dp / bb the whole catalog instead of the core left by reduce_to_core
+//   --core-search=N         kicks of local search on the incumbent that sets the core's bounds (default: 20)
+//   --portfolio             run several item orders on all cores and keep the best valid result
+//                           (--engine=greedy only)
+//   --threads=N             worker threads for --portfolio, --batch and --loader=parallel (default: all cores)
+//   --portfolio-random=N    extra orders with randomized tie-breaks (default: one per thread, at least 4)
+//   --local-search[=MS]     improve the greedy result with add/swap moves for MS milliseconds (default: 200)
+//   --compact               print the chosen items as compact JSON instead of indented
+//   --indices               print the chosen items' catalog indices instead of the items
+//   --output=PATH           write the results to PATH instead of stdout
+//   --alloc-report          print the heap allocations made while loading, solving and writing to stderr
+//                           (counted only when built with CPSOLVER_COUNT_ALLOCATIONS)
+//   --batch                 solve every parameter set in scenarios.json (a JSON array, or one object per
+//                           line; "-" for stdin) against the one catalog, a scenario per --threads thread,
+//                           printing one JSON line per scenario with its totals and chosen indices
+void parse_args(int argc, char * argv[], Catalog & catalog, Parameters & params, Options & options) {
+    options = Options(argc, argv);
+    const auto & paths = options.positional();
+    if (paths.size() == 2 && options.has("stream") && options.has("batch")) {
+        throw std::invalid_argument("--stream keeps only the candidates for one params.json and cannot be combined with --batch");
+    } else if (paths.size() == 2 && options.has("stream")) {
+        params = read_json<Parameters>(paths[1]);
+        CandidatePool pool(params);
+        if (paths[0] == "-") {
+            catalog = stream_catalog(std::cin, pool);
+        } else {
+            std::ifstream in(paths[0]);
+            if (!in) {
+                throw std::invalid_argument("cannot open " + paths[0]);
+            }
+            catalog = stream_catalog(in, pool);
+        }
+        cout << "Stream: " << pool.seen() << " items read, " << pool.size() << " kept as candidates" << endl;
+    } else if (paths.size() == 2) {
+        catalog = load_catalog<nlohmann::json>(paths[0], options);
+        if (!options.has("batch")) {
+            params = read_json<Parameters>(paths[1]);
+        }
+    }
 }
 
-void print_results(const Group & chosen, const Parameters & params)
+// Solves one parameter set with `engine`, as main does for params.json and
+// --batch does for each scenario. `sorted` is the catalog in sort_by_filter
+// order if the caller keeps one at hand; otherwise the greedy sorts lazily.
+SelectionMask solve(const Catalog & catalog, const ItemTable & table, const Parameters & params, const string & engine,
+  const Order * sorted, const Options & options, std::ostream & log)
 {
-  auto [val_params, invalid] = check_valid(chosen, params);
-
-  if (invalid) {
-    cout << "Invalid";
+  // auto takes dp when its table and bitset fit for the items it would be given, bb otherwise
+  auto exact_engine = [&engine](const Parameters & exact_params, std::size_t item_count) -> string {
+    if (engine != "auto") {
+      return engine;
+    }
+    return dp_applicable(exact_params, item_count) ? "dp" : "bb";
+  };
+
+  SelectionMask chosen;
+  const bool exact = engine == "dp" || engine == "bb" || engine == "auto";
+  if (exact && options.has("no-core")) {
+    chosen = find_exact(catalog, params, 0, exact_engine(params, catalog.items.size()), options, log);
+  } else if (exact) {
+    auto incumbent = find_grouping(catalog, params, portfolio_order(catalog, params, 3));
+    local_search(catalog, params, incumbent, static_cast<std::size_t>(options.get_long("core-search", 20)));
+    auto lower_bound = check_valid(table, incumbent, params).second ? 0 : table.sum_value(incumbent);
+
+    auto core = reduce_to_core(catalog, params, lower_bound);
+    log << "Core: " << core.undecided() << " of " << catalog.items.size() << " items undecided ("
+      << core.fixed_in.count() << " fixed in, " << core.fixed_out << " fixed out)" << endl;
+
+    if (core.proves_incumbent(params)) {
+      log << "Core: nothing can beat the incumbent, which is optimal" << endl;
+      chosen = std::move(incumbent);
+    } else {
+      auto fixed_value = core.fixed_in_total(&Item::value);
+      auto to_beat = lower_bound > fixed_value ? lower_bound - fixed_value : 0;
+      auto remaining = core.remaining(params);
+      chosen = core.expand_undecided(find_exact(core.undecided_catalog(), remaining, to_beat,
+        exact_engine(remaining, core.undecided()), options, log), catalog.items.size());
+      if (check_valid(table, chosen, params).second || table.sum_value(chosen) < lower_bound) {
+        chosen = std::move(incumbent);
+      }
+    }
+  } else if (engine != "greedy") {
+    throw std::invalid_argument("unknown engine: " + engine);
+  } else if (options.has("portfolio")) {
+    ThreadPool pool(static_cast<std::size_t>(options.get_long("threads", static_cast<long>(ThreadPool::default_size()))));
+    auto random_orders = static_cast<std::size_t>(options.get_long("portfolio-random", static_cast<long>(std::max<std::size_t>(pool.size(), 4))));
+    chosen = run_portfolio(catalog, params, find_grouping, pool, random_orders);
+  } else if (sorted != nullptr) {
+    chosen = find_grouping(catalog, params, *sorted);
   } else {
-    cout << "Valid";
+    chosen = with_compact_items(catalog, [&](const auto & items) {
+      LazyOrder order(items.size(), [&items](std::uint32_t a, std::uint32_t b) {
+        return sort_by_filter(items[a], items[b]);
+      });
+      return capacity_greedy(catalog, items, params, order);
+    });
   }
 
-  auto total_value = sum_value(chosen);
-
-  cout << " Parameters" << endl;
-  cout << "Value: " << total_value << endl;
-  cout << "Weight: " << val_params.max_weight << endl;
-  cout << "Volume: " << val_params.max_volume << endl;
-  cout << endl;
-  cout << "Chosen:" << endl;
-
-  nlohmann::json data;
-  to_json(data, chosen);
-
-  cout << data.dump(4) << endl;
+  if (options.has("local-search")) {
+    auto budget = std::chrono::milliseconds(options.get_long("local-search", 200));
+    auto stats = local_search(catalog, params, chosen, budget);
+    log << "Local search: " << stats.moves << " moves, " << stats.kicks << " kicks, value "
+      << stats.start_value << " -> " << stats.final_value << endl;
+  }
+  return chosen;
 }
 
-void parse_args(int argc, char * argv[], vector<Item> & items, Parameters & params) {
-    if (argc == 3) {
-        const char * cur_val = *(argv+1);
-        string itemsPath(cur_val, std::char_traits<char>::length(cur_val));
-        items = read_json<vector<Item>>(itemsPath);
-
-        const char * cur_val2 = *(argv+2);
-        string paramPath(cur_val2, std::char_traits<char>::length(cur_val2));
-        params = read_json<Parameters>(paramPath);
-    }
+// One line of --batch output: the scenario's totals and the catalog indices it chose
+void write_batch_result(ResultWriter & out, std::size_t scenario, const ItemTable & table, const SelectionMask & chosen,
+  const Parameters & params)
+{
+  auto [val_params, invalid] = check_valid(table, chosen, params);
+
+  out.begin_object();
+  out.key("chosen");
+  out.begin_array();
+  chosen.for_each([&out](std::size_t i) {
+    out.value(i);
+  });
+  out.end_array();
+  out.key("scenario");
+  out.value(scenario);
+  out.key("valid");
+  out.value(!invalid);
+  out.key("value");
+  out.value(table.sum_value(chosen));
+  out.key("volume");
+  out.value(val_params.max_volume);
+  out.key("weight");
+  out.value(val_params.max_weight);
+  out.end_object();
+  out << '\n';
 }
 
 // Should output:
+// Core: 0 of 3 items undecided (3 fixed in, 0 fixed out)
+// Core: nothing can beat the incumbent, which is optimal
 // Valid Parameters
 // Weight: 19
 // Volume: 0
@@ -229,17 +305,64 @@ void parse_args(int argc, char * argv[], vector<Item> & items, Parameters & para
 //     }
 // ]
 int main(int argc, char * argv[]) {
-  vector<Item> items = { {10, 10, 0, "a", "p1"}, {3, 2, 0, "b", "p2"}, {10, 9, 0, "c", "p1"} };
+  AllocationReport allocations;
+
+  Catalog catalog = { {10, 10, 0, "a", "p1"}, {3, 2, 0, "b", "p2"}, {10, 9, 0, "c", "p1"} };
 
   Parameters params = {20, 20};
 
-  parse_args(argc, argv, items, params);
+  Options options;
+  parse_args(argc, argv, catalog, params, options);
+  allocations.mark("load");
 
-  sort(items.begin(), items.end(), sort_by_filter);
+  auto engine = options.get("engine", "auto");
+  if (engine != "greedy" && (options.has("portfolio") || options.has("portfolio-random"))) {
+    throw std::invalid_argument("--portfolio and --portfolio-random run greedy orders and need --engine=greedy");
+  }
+  if (options.has("portfolio-random") && !options.has("portfolio")) {
+    throw std::invalid_argument("--portfolio-random only applies with --portfolio");
+  }
+  if (options.has("threads") && !options.has("portfolio") && !options.has("batch") &&
+    options.get("loader", "mmap") != "parallel") {
+    throw std::invalid_argument("--threads only applies with --portfolio, --batch or --loader=parallel");
+  }
 
-  auto chosen = find_grouping(items, params);
+  ItemTable table(catalog);
 
-  print_results(chosen, params);
+  if (options.has("batch")) {
+    if (options.has("portfolio")) {
+      throw std::invalid_argument("--portfolio cannot be combined with --batch, which already runs a scenario per thread");
+    }
+    auto scenarios = read_scenarios<nlohmann::json>(options.positional().at(1));
+    auto sorted = filter_order(catalog);
+
+    ThreadPool pool(static_cast<std::size_t>(options.get_long("threads", static_cast<long>(ThreadPool::default_size()))));
+    auto results = solve_batch(scenarios, pool, [&](const Parameters & scenario) {
+      std::ostringstream log;
+      return solve(catalog, table, scenario, engine, &sorted, options, log);
+    });
+    ResultWriter out(false);
+    for (std::size_t k = 0; k < results.size(); ++k) {
+      write_batch_result(out, k, table, results[k], scenarios[k]);
+    }
+    cout.flush();
+    out.write(options.get("output"));
+    allocations.mark("solve and output");
+    if (options.has("alloc-report")) {
+      allocations.print(std::cerr);
+    }
+    return 0;
+  }
+
+  auto chosen = solve(catalog, table, params, engine, nullptr, options, cout);
+
+  allocations.mark("solve");
+
+  print_results(catalog, table, chosen, params, options);
+  allocations.mark("output");
+  if (options.has("alloc-report")) {
+    allocations.print(std::cerr);
+  }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -4,184 +4,77 @@
 #include <cstdint>
 #include <iostream>
 #include <algorithm>
-#include <compare>
-#include <unordered_map>
 #include <fstream>
-
-#include <numeric>
+#include <chrono>
+#include <stdexcept>
+#include <ostream>
+#include <sstream>
 
 #include "json.hpp"
 
-using Amount = std::uint64_t;
+#include "item.hpp"
+#include "catalog.hpp"
+#include "catalog_loader.hpp"
+#include "parameters.hpp"
+#include "options.hpp"
+#include "selection_mask.hpp"
+#include "item_table.hpp"
+#include "order.hpp"
+#include "thread_pool.hpp"
+#include "portfolio.hpp"
+#include "local_search.hpp"
+#include "constrained_greedy.hpp"
+#include "batch.hpp"
+#include "result_writer.hpp"
+#include "allocation_counter.hpp"
 
 using std::string;
 using std::vector;
 using std::cout;
 using std::endl;
-using std::sort;
 using std::pair;
-using std::accumulate;
-using std::unordered_map;
-
-struct Item {
-  Amount value;
-  Amount weight;
-  Amount volume;
-  string manufacturer;
-  string type;
-};
-
-using Group = vector<Item>;
-
-struct Parameters {
-  Amount max_weight;
-  Amount max_volume;
-  Amount min_value;
-  double high_value_max;
-  double high_man_max;
-  double high_type_max;
-};
-
-constexpr Amount sum_value(const Group & selected) {
-  return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-    [](const Amount & a, const Item & b) {
-      return a + b.value;
-    }
-  );
-}
 
-constexpr Amount sum_weight(const Group & selected) {
-  return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-    [](const Amount & a, const Item & b) {
-      return a + b.weight;
-    }
-  );
+SelectionMask find_grouping(const Catalog & catalog, const Parameters & params, const Order & order) {
+  return constrained_greedy(catalog, params, order);
 }
 
-constexpr bool above_weight(const Item & item, const Group & selected, const Amount & max_weight)
+// Keys in alphabetical order, as nlohmann::json used to write them
+void write_item(ResultWriter & out, const Item & i, const Catalog & catalog)
 {
-  return sum_weight(selected) + item.weight > max_weight;
-}
-
-constexpr Amount sum_volume(const Group & selected) {
-   return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-    [](const Amount & a, const Item & b) {
-      return a + b.volume;
-    }
-  );
+  out.begin_object();
+  out.key("manufacturer");
+  out.value(catalog.manufacturers.name(i.manufacturer));
+  out.key("type");
+  out.value(catalog.types.name(i.type));
+  out.key("value");
+  out.value(i.value);
+  out.key("volume");
+  out.value(i.volume);
+  out.key("weight");
+  out.value(i.weight);
+  out.end_object();
 }
 
-constexpr bool above_volume(const Item & item, const Group & selected, const Amount & max_volume)
+void write_chosen(ResultWriter & out, const SelectionMask & p, const Catalog & catalog, bool indices)
 {
-  return sum_volume(selected) + item.volume > max_volume;
-}
-
-Group find_grouping(const vector<Item> & items, const Parameters & params) {
-  
-  Group selected;
-
-  std::unordered_map<string, Amount> product_manufacturer_map;
-  std::unordered_map<string, Amount> product_type_map;
-  Amount total = 0;
-
-  for(auto item : items)
-  {
-    if (above_weight(item, selected, params.max_weight) ||
-      above_volume(item, selected, params.max_volume))
-    {
-      continue;
-    }
-
-    Amount man_total = 0;
-    auto product_manufacturer_value_it = product_manufacturer_map.find(item.manufacturer);
-    if (product_manufacturer_value_it != product_manufacturer_map.end()) {
-      man_total = product_manufacturer_value_it->second;
-    }
-
-    Amount type_total = 0;
-    auto product_type_value_it = product_type_map.find(item.type);
-    if (product_type_value_it != product_type_map.end()) {
-      type_total = product_type_value_it->second;
-    }
-
-    selected.push_back(item);
-    total += item.value;
-    product_manufacturer_map[item.manufacturer] = man_total;
-    product_type_map[item.type] = type_total;
-  }
-
-  // auto total_value = sum_value(selected);
-  if(total < params.min_value)
-  {
-    return {};
-  }
-
-  // This only helps exclude invalid solutions but we may be prevented from getting valid solutions
-  // e.g. if excluding the max item could yield a valid solution
-  auto max_value = std::max_element(selected.cbegin(), selected.cend(), [](auto a, auto b) {
-    return a.value < b.value;
+  // Listed best first, the order the greedy considers them in
+  Order chosen;
+  p.for_each([&](std::size_t i) {
+    chosen.push_back(static_cast<std::uint32_t>(i));
+  });
+  std::stable_sort(chosen.begin(), chosen.end(), [&catalog](std::uint32_t a, std::uint32_t b) {
+    return sort_by_filter(catalog.items[a], catalog.items[b]);
   });
-  if(max_value->value > static_cast<Amount>(params.high_value_max * static_cast<double>(total))) {
-    return {};
-  }
-
-  // This could miss valid solutions. As we only check afterwards. It doesn't influence our decision.
-  for(auto [key, man_total] : product_manufacturer_map)
-  {
-    if (man_total > static_cast<Amount>(params.high_man_max * static_cast<double>(total))) {
-      return {};
-    }
-  }
 
-  // This could miss valid solutions. As we only check afterwards. It doesn't influence our decision.
-  for(auto [key, type_total] : product_type_map)
-  {
-    if (type_total > static_cast<Amount>(params.high_type_max * static_cast<double>(total))) {
-      return {};
+  out.begin_array();
+  for (auto i : chosen) {
+    if (indices) {
+      out.value(i);
+    } else {
+      write_item(out, catalog.items[i], catalog);
     }
   }
-
-  return selected;
-}
-
-template<typename V>
-void to_json(nlohmann::json & j, const vector<V> & p)
-{
-  for (auto & item: p)
-  {
-  nlohmann::json inner;
-  to_json(inner, item);
-  j.push_back(inner);
-  }
-}
-
-void to_json(nlohmann::json & j, const Item & i)
-{
-  j["value"] = i.value;
-  j["weight"] = i.weight;
-  j["volume"] = i.volume;
-  j["type"] = i.type;
-  j["manufacturer"] = i.manufacturer;
-}
-
-template<typename V>
-void from_json(const nlohmann::json& j, vector<V> & p)
-{
-  
-  for (auto & inner: j)
-  {
-    V item;
-    from_json(inner, item);
-    p.push_back(item);
-  }
-}
-
-void from_json(const nlohmann::json& j, Item& p) {
-    j.at("value").get_to(p.value);
-    j.at("weight").get_to(p.weight);
-    j.at("volume").get_to(p.volume);
-    j.at("product_type").get_to(p.type);
-    j.at("manufacturer").get_to(p.manufacturer);
+  out.end_array();
 }
 
 void from_json(const nlohmann::json& j, Parameters& p) {
@@ -205,48 +98,19 @@ V read_json(const std::string & file_path)
     return data;
 }
 
-pair<Parameters, bool> check_valid(const Group & selected, const Parameters & params)
+pair<Parameters, bool> check_valid(const ItemTable & table, const SelectionMask & selected, const Parameters & params)
 {
-  if (selected.empty()) {
+  if (!selected.any()) {
     return {{}, true};
   }
-  auto total_weight = sum_weight(selected);
-  auto total_volume = sum_volume(selected);
-
-  auto total_value = sum_value(selected);
-
-  auto max_value = std::max_element(selected.cbegin(), selected.cend(), [](auto a, auto b) {
-    return a.value < b.value;
-  });
-
-  unordered_map<string, Amount> prod_types;
-  unordered_map<string, Amount> man_types;
-
-  for(auto item : selected) {
-    auto prod_type = prod_types.find(item.type);
-    if(prod_type != prod_types.end())
-    {
-      prod_type->second += item.value;
-    }
-    else
-    {
-      prod_types[item.type] = item.value;
-    }
-
-    auto man_type = man_types.find(item.manufacturer);
-    if(man_type != man_types.end())
-    {
-      man_type->second += item.value;
-    }
-    else
-    {
-      man_types[item.manufacturer] = item.value;
-    }        
-  }
+  auto total_weight = table.sum_weight(selected);
+  auto total_volume = table.sum_volume(selected);
+  auto total_value = table.sum_value(selected);
+  auto max_value = table.max_value(selected);
 
   double max_prod_type = 0.0;
   bool invalid_prods = false;
-  for (auto [ptype, amount] : prod_types)
+  for (auto amount : table.value_by_type(selected))
   {
     auto prod_type = static_cast<double>(amount) / static_cast<double>(total_value);
     if (prod_type > max_prod_type)
@@ -258,7 +122,7 @@ pair<Parameters, bool> check_valid(const Group & selected, const Parameters & pa
 
   double max_man_type = 0.0;
   bool invalid_mans = false;
-  for (auto [mtype, amount] : man_types)
+  for (auto amount : table.value_by_manufacturer(selected))
   {
     auto man_type = static_cast<double>(amount) / static_cast<double>(total_value);
     if (man_type > max_man_type)
@@ -268,7 +132,7 @@ pair<Parameters, bool> check_valid(const Group & selected, const Parameters & pa
     invalid_mans = invalid_mans || man_type > params.high_man_max;
   }
 
-  auto max_value_percent = static_cast<double>(max_value->value) / static_cast<double>(total_value);
+  auto max_value_percent = static_cast<double>(max_value) / static_cast<double>(total_value);
 
   return {{total_weight, total_volume, total_value, max_value_percent, max_man_type, max_prod_type},
     total_weight > params.max_weight || total_volume > params.max_volume ||
@@ -276,68 +140,111 @@ pair<Parameters, bool> check_valid(const Group & selected, const Parameters & pa
     invalid_prods || invalid_mans };
 }
 
-// Sort by value, weight, and volume
-constexpr bool sort_by_filter(const Item & a, const Item & b) {
-  auto res = a.value <=> b.value;
-  if (res < 0) {
-    return false;
-  } else if (res > 0) {
-    return true;
-  }
+void print_results(const Catalog & catalog, const ItemTable & table, const SelectionMask & chosen, const Parameters & params,
+  const Options & options)
+{
+  auto [val_params, invalid] = check_valid(table, chosen, params);
 
-  res = a.weight <=> b.weight;
-  if (res < 0) {
-    return false;
-  } else if (res > 0) {
-    return true;
-  }
+  ResultWriter out(!options.has("compact"));
+  out << (invalid ? "Invalid" : "Valid") << " Parameters\n";
+  out << "Value: " << val_params.min_value << '\n';
+  out << "Weight: " << val_params.max_weight << '\n';
+  out << "Volume: " << val_params.max_volume << '\n';
 
-  res = a.volume <=> b.volume;
-  if (res < 0) {
-    return false;
-  } else if (res > 0) {
-    return true;
-  }
-  return false;
+  out << "Man Types: " << val_params.high_man_max << '\n';
+  out << "Prod Types: " << val_params.high_type_max << '\n';
+
+  out << '\n';
+  out << "Chosen:\n";
+  write_chosen(out, chosen, catalog, options.has("indices"));
+  out << '\n';
+
+  cout.flush();
+  out.write(options.get("output"));
 }
 
-void print_results(const Group & chosen, const Parameters & params)
-{
-  auto [val_params, invalid] = check_valid(chosen, params);
+// Usage: greedy_example_2 [items.json params.json] [options]
+//        greedy_example_2 items.json scenarios.json --batch [options]
+//   --loader=L              mmap (default; maps the items file and parses it in place), parallel (the same,
+//                           parsed in chunks on --threads threads) or sax; the mmap loaders also read
+//                           binary catalogs written by catalog_convert
+//   --portfolio             run several item orders on all cores and keep the best valid result
+//   --threads=N             worker threads for --portfolio, --batch and --loader=parallel (default: all cores)
+//   --portfolio-random=N    extra orders with randomized tie-breaks (default: one per thread, at least 4)
+//   --local-search[=MS]     improve the greedy result with add/swap moves for MS milliseconds (default: 200)
+//   --compact               print the chosen items as compact JSON instead of indented
+//   --indices               print the chosen items' catalog indices instead of the items
+//   --output=PATH           write the results to PATH instead of stdout
+//   --alloc-report          print the heap allocations made while loading, solving and writing to stderr
+//                           (counted only when built with CPSOLVER_COUNT_ALLOCATIONS)
+//   --batch                 solve every parameter set in scenarios.json (a JSON array, or one object per
+//                           line; "-" for stdin) against the one catalog, a scenario per --threads thread,
+//                           printing one JSON line per scenario with its totals, shares and chosen indices
+void parse_args(int argc, char * argv[], Catalog & catalog, Parameters & params, Options & options) {
+    options = Options(argc, argv);
+    const auto & paths = options.positional();
+    if (paths.size() == 2) {
+        catalog = load_catalog<nlohmann::json>(paths[0], options);
+        if (!options.has("batch")) {
+            params = read_json<Parameters>(paths[1]);
+        }
+    }
+}
 
-  if (invalid) {
-    cout << "Invalid";
+// Solves one parameter set, as main does for params.json and --batch does for
+// each scenario, greedily over `sorted` (the catalog in sort_by_filter order)
+SelectionMask solve(const Catalog & catalog, const Parameters & params, const Order & sorted, const Options & options,
+  std::ostream & log)
+{
+  SelectionMask chosen;
+  if (options.has("portfolio")) {
+    ThreadPool pool(static_cast<std::size_t>(options.get_long("threads", static_cast<long>(ThreadPool::default_size()))));
+    auto random_orders = static_cast<std::size_t>(options.get_long("portfolio-random", static_cast<long>(std::max<std::size_t>(pool.size(), 4))));
+    chosen = run_portfolio(catalog, params, find_grouping, pool, random_orders);
   } else {
-    cout << "Valid";
+    chosen = find_grouping(catalog, params, sorted);
   }
-  
-  cout << " Parameters" << endl;
-  cout << "Value: " << val_params.min_value << endl;
-  cout << "Weight: " << val_params.max_weight << endl;
-  cout << "Volume: " << val_params.max_volume << endl;
-
-  cout << "Man Types: " << val_params.high_man_max << endl;
-  cout << "Prod Types: " << val_params.high_type_max << endl;
 
-  cout << endl;
-  cout << "Chosen:" << endl;
-
-  nlohmann::json data;
-  to_json(data, chosen);
-
-  cout << data.dump(4) << endl;
+  if (options.has("local-search")) {
+    auto budget = std::chrono::milliseconds(options.get_long("local-search", 200));
+    auto stats = local_search(catalog, params, chosen, budget);
+    log << "Local search: " << stats.moves << " moves, " << stats.kicks << " kicks, value "
+      << stats.start_value << " -> " << stats.final_value << endl;
+  }
+  return chosen;
 }
 
-void parse_args(int argc, char * argv[], vector<Item> & items, Parameters & params) {
-    if (argc == 3) {
-        const char * cur_val = *(argv+1);
-        string itemsPath(cur_val, std::char_traits<char>::length(cur_val));
-        items = read_json<vector<Item>>(itemsPath);
+// One line of --batch output: the scenario's totals and shares and the catalog indices it chose
+void write_batch_result(ResultWriter & out, std::size_t scenario, const ItemTable & table, const SelectionMask & chosen,
+  const Parameters & params)
+{
+  auto [val_params, invalid] = check_valid(table, chosen, params);
 
-        const char * cur_val2 = *(argv+2);
-        string paramPath(cur_val2, std::char_traits<char>::length(cur_val2));
-        params = read_json<Parameters>(paramPath);
-    }
+  out.begin_object();
+  out.key("chosen");
+  out.begin_array();
+  chosen.for_each([&out](std::size_t i) {
+    out.value(i);
+  });
+  out.end_array();
+  out.key("man_share");
+  out.value(val_params.high_man_max);
+  out.key("scenario");
+  out.value(scenario);
+  out.key("type_share");
+  out.value(val_params.high_type_max);
+  out.key("valid");
+  out.value(!invalid);
+  out.key("value");
+  out.value(val_params.min_value);
+  out.key("value_share");
+  out.value(val_params.high_value_max);
+  out.key("volume");
+  out.value(val_params.max_volume);
+  out.key("weight");
+  out.value(val_params.max_weight);
+  out.end_object();
+  out << '\n';
 }
 
 // Should output:
@@ -365,17 +272,53 @@ void parse_args(int argc, char * argv[], vector<Item> & items, Parameters & para
 //     }
 // ]
 int main(int argc, char * argv[]) {
-  vector<Item> items = { {10, 10, 10, "a", "p1"}, {3, 4, 9, "b", "p2"}, {3, 5, 2, "c", "p4"}, {2, 4, 4, "c", "p3"} };
+  AllocationReport allocations;
+
+  Catalog catalog = { {10, 10, 10, "a", "p1"}, {3, 4, 9, "b", "p2"}, {3, 5, 2, "c", "p4"}, {2, 4, 4, "c", "p3"} };
 
   Parameters params = {20, 20, 10, 0.8, 0.7, 0.7};
 
-  parse_args(argc, argv, items, params);
+  Options options;
+  parse_args(argc, argv, catalog, params, options);
+  allocations.mark("load");
 
-  sort(items.begin(), items.end(), sort_by_filter);
+  auto sorted = filter_order(catalog);
 
-  auto chosen = find_grouping(items, params);
+  ItemTable table(catalog);
 
-  print_results(chosen, params);
+  if (options.has("batch")) {
+    if (options.has("portfolio")) {
+      throw std::invalid_argument("--portfolio cannot be combined with --batch, which already runs a scenario per thread");
+    }
+    auto scenarios = read_scenarios<nlohmann::json>(options.positional().at(1));
+
+    ThreadPool pool(static_cast<std::size_t>(options.get_long("threads", static_cast<long>(ThreadPool::default_size()))));
+    auto results = solve_batch(scenarios, pool, [&](const Parameters & scenario) {
+      std::ostringstream log;
+      return solve(catalog, scenario, sorted, options, log);
+    });
+    ResultWriter out(false);
+    for (std::size_t k = 0; k < results.size(); ++k) {
+      write_batch_result(out, k, table, results[k], scenarios[k]);
+    }
+    cout.flush();
+    out.write(options.get("output"));
+    allocations.mark("solve and output");
+    if (options.has("alloc-report")) {
+      allocations.print(std::cerr);
+    }
+    return 0;
+  }
+
+  auto chosen = solve(catalog, params, sorted, options, cout);
+
+  allocations.mark("solve");
+
+  print_results(catalog, table, chosen, params, options);
+  allocations.mark("output");
+  if (options.has("alloc-report")) {
+    allocations.print(std::cerr);
+  }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -5,6 +5,11 @@
 #include <iostream>
 #include <algorithm>
 #include <fstream>
+#include <stdexcept>
+#include <chrono>
+#include <atomic>
+#include <memory_resource>
+#include <optional>
 
 #include "ortools/sat/cp_model.h"
 #include "ortools/sat/model.h"
@@ -16,7 +21,23 @@
 
 #include "json.hpp"
 
-using Amount = std::uint64_t;
+#include "item.hpp"
+#include "catalog.hpp"
+#include "catalog_loader.hpp"
+#include "parameters.hpp"
+#include "options.hpp"
+#include "selection_mask.hpp"
+#include "item_table.hpp"
+#include "result_writer.hpp"
+#include "solution_log.hpp"
+#include "termination.hpp"
+#include "allocation_counter.hpp"
+#include "knapsack_dp.hpp"
+#include "branch_and_bound.hpp"
+#include "capacity_greedy.hpp"
+#include "core_reduction.hpp"
+#include "local_search.hpp"
+#include "portfolio.hpp"
 
 using std::string;
 using std::vector;
@@ -37,101 +58,117 @@ using operations_research::sat::SolutionIntegerValue;
 using operations_research::sat::NewFeasibleSolutionObserver;
 using operations_research::ProtoEnumToString;
 
-struct Item {
-    Amount value;
-    Amount weight;
-    Amount volume;
-    string manufacturer;
-    string type;
-};
-
-using Group = vector<Item>;
-
-struct Parameters {
-    Amount max_weight;
-    Amount max_volume;
-    Amount min_value;
-    double high_value_max;
-    double high_man_max;
-    double high_type_max;
-};
-
-constexpr Amount sum_value(const Group & selected) {
-    return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-        [](const Amount & a, const Item & b) {
-            return a + b.value;
-        }
-    );
-}
-
-constexpr Amount sum_weight(const Group & selected) {
-    return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-        [](const Amount & a, const Item & b) {
-            return a + b.weight;
-        }
-    );
-}
-
-constexpr Amount sum_volume(const Group & selected) {
-   return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-        [](const Amount & a, const Item & b) {
-            return a + b.volume;
-        }
-    );
-}
-
 using int64 = int64_t;
 
-Group find_grouping(const vector<Item> & items, const Parameters & params) {
+// `hint`, if given, is a selection over catalog.items to start the search from
+SelectionMask find_grouping(const Catalog & catalog, const Parameters & params, const SelectionMask & fixed_in,
+    const SelectionMask * hint, const Termination & termination, const Options & options) {
+    const auto & items = catalog.items;
 
     CpModelBuilder model_builder;
     
-    Group selected;
+    SelectionMask selected(items.size());
 
-    const int64 scaling_factor = 1000;
+    // The model's scratch arrays live in one arena for the length of the
+    // solve, so building them costs a handful of allocations, not one per array
+    std::pmr::monotonic_buffer_resource arena(std::max<std::size_t>(items.size(), 1) * 64);
 
     // Define variables
-    vector<IntVar> within_pool(items.size());
-    vector<int64> value_scaled(items.size());
-    vector<int64> weight_scaled(items.size());
-    vector<int64> volume_scaled(items.size());
+    std::pmr::vector<IntVar> within_pool(items.size(), &arena);
+    std::pmr::vector<int64> values(items.size(), &arena);
+    std::pmr::vector<int64> weights(items.size(), &arena);
+    std::pmr::vector<int64> volumes(items.size(), &arena);
 
     const Domain domain_from_zero(0, 1);
-    // const Domain domain_from_one(1, 1);
+    const Domain domain_from_one(1, 1);
     for(std::size_t i = 0; i < items.size(); ++i)
     {
-        within_pool[i] = model_builder.NewIntVar(domain_from_zero);
-        value_scaled[i] = static_cast<int64>(items[i].value) * scaling_factor;
-        weight_scaled[i] = static_cast<int64>(items[i].weight) * scaling_factor;
-        volume_scaled[i] = static_cast<int64>(items[i].volume) * scaling_factor;
+        within_pool[i] = model_builder.NewIntVar(fixed_in.test(i) ? domain_from_one : domain_from_zero);
+        values[i] = static_cast<int64>(items[i].value);
+        weights[i] = static_cast<int64>(items[i].weight);
+        volumes[i] = static_cast<int64>(items[i].volume);
     }
 
     // Define constraints
 
     // 1. SUM(v_i x u_i.weight) <= w_max
-    model_builder.AddLessOrEqual(LinearExpr::WeightedSum(within_pool, weight_scaled), static_cast<int64>(params.max_weight) * scaling_factor);
+    model_builder.AddLessOrEqual(LinearExpr::WeightedSum(within_pool, weights), static_cast<int64>(params.max_weight));
 
     // 2. SUM(v_i x u_i.volume) <= v_max
-    model_builder.AddLessOrEqual(LinearExpr::WeightedSum(within_pool, volume_scaled), static_cast<int64>(params.max_volume) * scaling_factor);
+    model_builder.AddLessOrEqual(LinearExpr::WeightedSum(within_pool, volumes), static_cast<int64>(params.max_volume));
 
     // MAX(SUM(v_i x u_i.value))
-    model_builder.Maximize(LinearExpr::WeightedSum(within_pool, value_scaled));
+    model_builder.Maximize(LinearExpr::WeightedSum(within_pool, values));
 
     // TODO add remaining constraints.
 
+    // CP-SAT tries the hinted assignment first and repairs what of it the
+    // model rejects, so a good incumbent gives it a first solution at once
+    if (hint != nullptr) {
+        for (size_t i = 0; i < items.size(); ++i) {
+            model_builder.AddHint(within_pool[i], hint->test(i) ? 1 : 0);
+        }
+    }
+
     // Run model
     Model model;
 
     SatParameters parameters;
     parameters.set_num_search_workers(4);
 
-    int max_time = 3 * 60;
-    parameters.set_max_time_in_seconds(max_time);
+    parameters.set_max_time_in_seconds(termination.time_limit);
+    if (termination.relative_gap > 0) {
+        parameters.set_relative_gap_limit(termination.relative_gap);
+    }
+    if (termination.absolute_gap > 0) {
+        parameters.set_absolute_gap_limit(termination.absolute_gap);
+    }
     model.Add(NewSatParameters(parameters));
 
+    // CP-SAT has no stall limit of its own; the watch raises this flag instead
+    std::atomic<bool> stop = false;
+    model.GetOrCreate<TimeLimit>()->RegisterExternalBooleanAsLimit(&stop);
+    StallWatch stall(termination.stall_seconds, [&stop] { stop = true; });
+
+    // Every solution CP-SAT finds passes through here: the first one's time is
+    // kept for --timings, and with --anytime each improving one is logged
+    std::optional<SolutionLog> anytime;
+    if (options.has("anytime")) {
+        anytime.emplace(options.get("anytime"));
+    }
+    const auto start = std::chrono::steady_clock::now();
+    double first_solution = -1;
+    model.Add(NewFeasibleSolutionObserver([&](const CpSolverResponse & solution) {
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (first_solution < 0) {
+            first_solution = seconds;
+        }
+        stall.improved();
+        if (anytime) {
+            std::size_t count = 0;
+            for (const auto & var : within_pool) {
+                count += SolutionIntegerValue(solution, var) >= 1 ? 1u : 0u;
+            }
+            anytime->record(seconds, solution.objective_value(), solution.best_objective_bound(), count);
+        }
+    }));
+
     const CpSolverResponse response = SolveCpModel(model_builder.Build(), &model);
+    stall.finish();
 
     cout << "Resp Status: " << ProtoEnumToString<CpSolverStatus>(response.status()) << endl;
+    cout << "Stop: " << stop_reason(response.status() == CpSolverStatus::OPTIMAL, response.status() == CpSolverStatus::INFEASIBLE,
+        stall.fired(), response.objective_value(), response.best_objective_bound()) << endl;
+    if (options.has("timings")) {
+        cout << "Timings: " << (hint != nullptr ? "hinted" : "cold") << ", first solution ";
+        if (first_solution < 0) {
+            cout << "none";
+        } else {
+            cout << "after " << first_solution << " s";
+        }
+        cout << ", " << (response.status() == CpSolverStatus::OPTIMAL ? "optimal" : "stopped")
+            << " after " << response.wall_time() << " s" << endl;
+    }
 
     if (
         response.status() != CpSolverStatus::OPTIMAL &&
@@ -145,48 +182,56 @@ Group find_grouping(const vector<Item> & items, const Parameters & params) {
     {
         if (SolutionIntegerValue(response, within_pool[i]) >= 1)
         {
-            selected.push_back(items[i]);
+            selected.set(i);
         }
     }
     return selected;
 }
 
-template<typename V>
-void to_json(nlohmann::json & j, const vector<V> & p)
+// `to_beat` is the value of a known selection; bb then only looks for better ones
+SelectionMask find_exact(const Catalog & catalog, const Parameters & params, const SelectionMask & fixed_in,
+    const SelectionMask * hint, Amount to_beat, const string & engine, const Termination & termination, const Options & options)
 {
-  for (auto & item: p)
-  {
-    nlohmann::json inner;
-    to_json(inner, item);
-    j.push_back(inner);
-  }
+    if (engine == "dp") {
+        cout << "Resp Status: OPTIMAL (dp)" << endl;
+        return knapsack_dp(catalog, params);
+    }
+    if (engine == "bb") {
+        auto node_limit = static_cast<std::size_t>(options.get_long("node-limit", static_cast<long>(default_node_limit)));
+        auto result = branch_and_bound(catalog, params, node_limit, to_beat);
+        cout << "Resp Status: " << (result.optimal ? "OPTIMAL" : "FEASIBLE") << " (bb, " << result.nodes << " nodes)" << endl;
+        return std::move(result.selected);
+    }
+    if (engine == "cp-sat") {
+        return find_grouping(catalog, params, fixed_in, hint, termination, options);
+    }
+    throw std::invalid_argument("unknown engine: " + engine);
 }
 
-void to_json(nlohmann::json & j, const Item & i)
+// Keys in alphabetical order, as nlohmann::json used to write them
+void write_item(ResultWriter & out, const Item & i)
 {
-    j["value"] = i.value;
-    j["weight"] = i.weight;
-    j["volume"] = i.volume;
+    out.begin_object();
+    out.key("value");
+    out.value(i.value);
+    out.key("volume");
+    out.value(i.volume);
+    out.key("weight");
+    out.value(i.weight);
+    out.end_object();
 }
 
-template<typename V>
-void from_json(const nlohmann::json& j, vector<V> & p)
+void write_chosen(ResultWriter & out, const SelectionMask & p, const Catalog & catalog, bool indices)
 {
-  
-  for (auto & inner: j)
-  {
-    V item;
-    from_json(inner, item);
-    p.push_back(item);
-  }
-}
-
-void from_json(const nlohmann::json& j, Item& p) {
-    j.at("value").get_to(p.value);
-    j.at("weight").get_to(p.weight);
-    j.at("volume").get_to(p.volume);
-    j.at("product_type").get_to(p.type);
-    j.at("manufacturer").get_to(p.manufacturer);
+    out.begin_array();
+    p.for_each([&](std::size_t i) {
+        if (indices) {
+            out.value(i);
+        } else {
+            write_item(out, catalog.items[i]);
+        }
+    });
+    out.end_array();
 }
 
 void from_json(const nlohmann::json& j, Parameters& p) {
@@ -210,51 +255,75 @@ V read_json(const std::string & file_path)
     return data;
 }
 
-constexpr pair<Parameters, bool> check_valid(const Group & selected, const Parameters & params)
+pair<Parameters, bool> check_valid(const ItemTable & table, const SelectionMask & selected, const Parameters & params)
 {
-    auto total_weight = sum_weight(selected);
-    auto total_volume = sum_volume(selected);
+    auto total_weight = table.sum_weight(selected);
+    auto total_volume = table.sum_volume(selected);
     return {{total_weight, total_volume}, total_weight > params.max_weight || total_volume > params.max_volume};
 }
 
-void print_results(const Group & chosen, const Parameters & params)
+void print_results(const Catalog & catalog, const ItemTable & table, const SelectionMask & chosen, const Parameters & params,
+    const Options & options)
 {
-    auto [val_params, invalid] = check_valid(chosen, params);
+    auto [val_params, invalid] = check_valid(table, chosen, params);
 
-    if (invalid) {
-        cout << "Invalid";
-    } else {
-        cout << "Valid";
-    }
+    ResultWriter out(!options.has("compact"));
+    out << (invalid ? "Invalid" : "Valid");
 
-    auto total_value = sum_value(chosen);
+    auto total_value = table.sum_value(chosen);
 
-    cout << " Parameters" << endl;
-    cout << "Value: " << total_value << endl;
-    cout << "Weight: " << val_params.max_weight << endl;
-    cout << "Volume: " << val_params.max_volume << endl;
-    cout << endl;
-    cout << "Chosen:" << endl;
+    out << " Parameters\n";
+    out << "Value: " << total_value << '\n';
+    out << "Weight: " << val_params.max_weight << '\n';
+    out << "Volume: " << val_params.max_volume << '\n';
+    out << '\n';
+    out << "Chosen:\n";
 
-    nlohmann::json data;
-    to_json(data, chosen);
+    write_chosen(out, chosen, catalog, options.has("indices"));
+    out << '\n';
 
-    cout << data.dump(4) << endl;
+    cout.flush();
+    out.write(options.get("output"));
 }
 
-void parse_args(int argc, char * argv[], vector<Item> & items, Parameters & params) {
-    if (argc == 3) {
-        const char * cur_val = *(argv+1);
-        string itemsPath(cur_val, std::char_traits<char>::length(cur_val));
-        items = read_json<vector<Item>>(itemsPath);
-
-        const char * cur_val2 = *(argv+2);
-        string paramPath(cur_val2, std::char_traits<char>::length(cur_val2));
-        params = read_json<Parameters>(paramPath);
+// Usage: cpsolver_example_1 [items.json params.json] [options]
+//   --loader=L        mmap (default; maps the items file and parses it in place), parallel (the same,
+//                     parsed in chunks on --threads threads) or sax; the mmap loaders also read
+//                     binary catalogs written by catalog_convert
+//   --threads=N       threads for --loader=parallel (default: all cores)
+//   --engine=E        cp-sat, dp (exact, small capacities only), bb (native branch and bound, exact only
+//                     if it finishes within --node-limit, otherwise the best selection found)
+//                     or auto (default): dp when max_weight x max_volume fits dp_max_cells and
+//                     its bitset for the core's items fits dp_max_taken_bytes, cp-sat otherwise
+//   --node-limit=N    nodes bb explores before settling for its best selection so far (default: 1000000)
+//   --no-core         hand the engine the whole catalog instead of the core left by reduce_to_core
+//   --core-search=N   kicks of local search on the incumbent that sets the core's bounds (default: 20)
+//   --no-hint         start cp-sat cold instead of from the incumbent
+//   --timings         print when cp-sat found its first solution and when it finished
+//   --anytime[=PATH]  log each improving solution as it is found, one JSON line with its time
+//                     in seconds, objective, bound and item count, to PATH or stdout
+//   --gap=G           stop once the solver's bound is within a fraction G of its best solution
+//   --abs-gap=A       stop once the bound is within A of the best solution
+//   --stall=S         stop after S seconds without an improving solution
+//   --deadline=S      seconds the whole run may take; the solver gets what loading and the
+//                     core reduction leave of it (default: a 180 s solver limit)
+//   --compact         print the chosen items as compact JSON instead of indented
+//   --indices         print the chosen items' catalog indices instead of the items
+//   --output=PATH     write the results to PATH instead of stdout
+//   --alloc-report    print the heap allocations made while loading, solving and writing to stderr
+//                     (counted only when built with CPSOLVER_COUNT_ALLOCATIONS)
+void parse_args(int argc, char * argv[], Catalog & catalog, Parameters & params, Options & options) {
+    options = Options(argc, argv);
+    const auto & paths = options.positional();
+    if (paths.size() == 2) {
+        catalog = load_catalog<nlohmann::json>(paths[0], options);
+        params = read_json<Parameters>(paths[1]);
     }
 }
 
 // Should output:
+// Core: 0 of 4 items undecided (4 fixed in, 0 fixed out)
+// Resp Status: OPTIMAL (core reduction)
 // Valid Parameters
 // Value: 15
 // Weight: 19
@@ -279,15 +348,75 @@ void parse_args(int argc, char * argv[], vector<Item> & items, Parameters & para
 //     }
 // ]
 int main(int argc, char * argv[]) {
-    vector<Item> items = { {10, 10, 10, "a", "p1"}, {3, 4, 9, "b", "p2"}, {3, 5, 2, "c", "p1"}, {2, 4, 4, "c", "p1"} };
+    AllocationReport allocations;
+    const auto started = std::chrono::steady_clock::now();
+
+    Catalog catalog = { {10, 10, 10, "a", "p1"}, {3, 4, 9, "b", "p2"}, {3, 5, 2, "c", "p1"}, {2, 4, 4, "c", "p1"} };
 
     Parameters params = {20, 20, 10, 0.8, 0.025, 0.025};
 
-    parse_args(argc, argv, items, params);
+    Options options;
+    parse_args(argc, argv, catalog, params, options);
+    allocations.mark("load");
+
+    // auto takes dp when its table and bitset fit for the items it would be given, cp-sat otherwise
+    const auto engine = options.get("engine", "auto");
+    auto exact_engine = [&engine](const Parameters & exact_params, std::size_t item_count) -> string {
+        if (engine != "auto") {
+            return engine;
+        }
+        return dp_applicable(exact_params, item_count) ? "dp" : "cp-sat";
+    };
+
+    ItemTable table(catalog);
 
-    auto chosen = find_grouping(items, params);
+    SelectionMask chosen;
+    if (options.has("no-core")) {
+        chosen = find_exact(catalog, params, SelectionMask(catalog.items.size()), nullptr, 0,
+            exact_engine(params, catalog.items.size()), read_termination(options, started), options);
+    } else {
+        // This model has no value floor or share limits, so neither does the incumbent
+        const Parameters capacity = {params.max_weight, params.max_volume};
+        auto incumbent = capacity_greedy(catalog, capacity, portfolio_order(catalog, capacity, 3));
+        local_search(catalog, capacity, incumbent, static_cast<std::size_t>(options.get_long("core-search", 20)));
+        auto lower_bound = table.sum_value(incumbent);
+
+        auto core = reduce_to_core(catalog, capacity, lower_bound);
+        cout << "Core: " << core.undecided() << " of " << catalog.items.size() << " items undecided ("
+            << core.fixed_in.count() << " fixed in, " << core.fixed_out << " fixed out)" << endl;
+
+        if (core.proves_incumbent(capacity)) {
+            // Nothing can beat the incumbent, so there is no model to solve
+            cout << "Resp Status: OPTIMAL (core reduction)" << endl;
+            chosen = std::move(incumbent);
+        } else {
+            auto remaining = core.remaining(params);
+            auto core_engine = exact_engine(remaining, core.undecided());
+            if (core_engine == "dp" || core_engine == "bb") {
+                // These take no fixed-in set, so they solve the undecided items in what the fixed-in ones leave
+                auto fixed_value = core.fixed_in_total(&Item::value);
+                auto to_beat = lower_bound > fixed_value ? lower_bound - fixed_value : 0;
+                chosen = core.expand_undecided(find_exact(core.undecided_catalog(), remaining,
+                    SelectionMask(core.undecided()), nullptr, to_beat, core_engine, read_termination(options, started), options),
+                    catalog.items.size());
+            } else {
+                auto hint = core.restrict(incumbent);
+                chosen = core.expand(find_exact(core.catalog, params, core.fixed_in, options.has("no-hint") ? nullptr : &hint, 0,
+                    core_engine, read_termination(options, started), options), catalog.items.size());
+            }
+            if (check_valid(table, chosen, params).second || table.sum_value(chosen) < lower_bound) {
+                chosen = std::move(incumbent);
+            }
+        }
+    }
 
-    print_results(chosen, params);
+    allocations.mark("solve");
+
+    print_results(catalog, table, chosen, params, options);
+    allocations.mark("output");
+    if (options.has("alloc-report")) {
+        allocations.print(std::cerr);
+    }
 
     return 0;
 }
\ No newline at end of file
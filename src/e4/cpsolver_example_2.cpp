@@ -4,9 +4,11 @@
 #include <cstdint>
 #include <iostream>
 #include <algorithm>
-#include <unordered_map>
-#include <set>
 #include <fstream>
+#include <chrono>
+#include <atomic>
+#include <memory_resource>
+#include <optional>
 
 #include "ortools/sat/cp_model.h"
 #include "ortools/sat/model.h"
@@ -18,18 +20,33 @@
 
 #include "json.hpp"
 
-using Amount = std::uint64_t;
+#include "item.hpp"
+#include "catalog.hpp"
+#include "catalog_loader.hpp"
+#include "parameters.hpp"
+#include "options.hpp"
+#include "selection_mask.hpp"
+#include "item_table.hpp"
+#include "result_writer.hpp"
+#include "solution_log.hpp"
+#include "termination.hpp"
+#include "ratio.hpp"
+#include "allocation_counter.hpp"
+#include "order.hpp"
+#include "portfolio.hpp"
+#include "constrained_greedy.hpp"
+#include "local_search.hpp"
+#include "core_reduction.hpp"
 
 using std::string;
 using std::vector;
 using std::cout;
 using std::endl;
-using std::set;
 using std::pair;
-using std::unordered_map;
 using std::size_t;
 
 using operations_research::Domain;
+using operations_research::TimeLimit;
 using operations_research::sat::CpModelBuilder;
 using operations_research::sat::CpSolverResponse;
 using operations_research::sat::CpSolverStatus;
@@ -38,51 +55,9 @@ using operations_research::sat::LinearExpr;
 using operations_research::sat::Model;
 using operations_research::sat::SatParameters;
 using operations_research::sat::SolutionIntegerValue;
+using operations_research::sat::NewFeasibleSolutionObserver;
 using operations_research::ProtoEnumToString;
 
-struct Item {
-    Amount value;
-    Amount weight;
-    Amount volume;
-    string manufacturer;
-    string type;
-};
-
-using Group = vector<Item>;
-
-struct Parameters {
-    Amount max_weight;
-    Amount max_volume;
-    Amount min_value;
-    double high_value_max;
-    double high_man_max;
-    double high_type_max;
-};
-
-constexpr Amount sum_value(const Group & selected) {
-    return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-        [](const Amount & a, const Item & b) {
-            return a + b.value;
-        }
-    );
-}
-
-constexpr Amount sum_weight(const Group & selected) {
-    return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-        [](const Amount & a, const Item & b) {
-            return a + b.weight;
-        }
-    );
-}
-
-constexpr Amount sum_volume(const Group & selected) {
-   return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-        [](const Amount & a, const Item & b) {
-            return a + b.volume;
-        }
-    );
-}
-
 using int64 = int64_t;
 
 enum class FourthConstraintMode {
@@ -90,25 +65,42 @@ enum class FourthConstraintMode {
     max_equality = 1,
     max_all = 2 };
 
-Group find_grouping(const vector<Item> & items, const Parameters & params) {
+// `hint`, if given, is a selection over catalog.items to start the search from
+SelectionMask find_grouping(const Catalog & catalog, const Parameters & params, const SelectionMask & fixed_in,
+    const SelectionMask * hint, const Termination & termination, const Options & options) {
+    const auto & items = catalog.items;
+
+    // The model is built around the most valuable item, so it needs one. With
+    // no items only the empty selection is left, and constraint 3 asks for a
+    // total above min_value.
+    if (items.empty()) {
+        cout << "Resp Status: INFEASIBLE (no items)" << endl;
+        cout << "Stop: infeasible" << endl;
+        return {};
+    }
 
     CpModelBuilder model_builder;
     
-    Group selected;
+    SelectionMask selected(items.size());
 
-    const int64 scaling_factor = 1000;
+    // Share limits as exact fractions, cross-multiplied into the constraints
+    // so coefficients stay at the size of the item values
+    const Ratio value_share = to_ratio(params.high_value_max);
+    const Ratio type_share = to_ratio(params.high_type_max);
+    const Ratio man_share = to_ratio(params.high_man_max);
+
+    // The model's scratch arrays live in one arena for the length of the
+    // solve, so building them costs a handful of allocations, not one per array
+    std::pmr::monotonic_buffer_resource arena(std::max<std::size_t>(items.size(), 1) * 64);
 
     // Define variables
-    vector<IntVar> within_pool(items.size());
-    vector<int64> value_scaled(items.size());
-    vector<int64> weight_scaled(items.size());
-    vector<int64> volume_scaled(items.size());
+    std::pmr::vector<IntVar> within_pool(items.size(), &arena);
+    std::pmr::vector<int64> values(items.size(), &arena);
+    std::pmr::vector<int64> weights(items.size(), &arena);
+    std::pmr::vector<int64> volumes(items.size(), &arena);
 
     vector<LinearExpr> val_sets(items.size());
 
-    set<string> product_types;
-    set<string> manufacturer_types;
-
     auto max_value = std::max_element(items.cbegin(), items.cend(), [](auto a, auto b) {
         return a.value < b.value;
     });
@@ -124,41 +116,89 @@ Group find_grouping(const vector<Item> & items, const Parameters & params) {
         if (constraint_four_setting == FourthConstraintMode::force_max && i == max_index) {
             within_pool[i] = model_builder.NewIntVar(domain_from_one);
         } else {
-            within_pool[i] = model_builder.NewIntVar(domain_from_zero);
+            within_pool[i] = model_builder.NewIntVar(fixed_in.test(i) ? domain_from_one : domain_from_zero);
         }
-        value_scaled[i] = static_cast<int64>(items[i].value) * scaling_factor;
-        weight_scaled[i] = static_cast<int64>(items[i].weight) * scaling_factor;
-        volume_scaled[i] = static_cast<int64>(items[i].volume) * scaling_factor;
+        values[i] = static_cast<int64>(items[i].value);
+        weights[i] = static_cast<int64>(items[i].weight);
+        volumes[i] = static_cast<int64>(items[i].volume);
 
         if (constraint_four_setting == FourthConstraintMode::max_equality) {
             val_sets.push_back(LinearExpr::Term(within_pool[i], static_cast<int64>(items[i].value)));
         }
-
-        product_types.insert(items[i].type);
-        manufacturer_types.insert(items[i].manufacturer);
     }
 
     // Define constraints
 
     // 1. SUM(v_i x u_i.weight) <= w_max
-    model_builder.AddLessOrEqual(LinearExpr::WeightedSum(within_pool, weight_scaled), static_cast<int64>(params.max_weight) * scaling_factor);
+    model_builder.AddLessOrEqual(LinearExpr::WeightedSum(within_pool, weights), static_cast<int64>(params.max_weight));
 
     // 2. SUM(v_i x u_i.volume) <= v_max
-    model_builder.AddLessOrEqual(LinearExpr::WeightedSum(within_pool, volume_scaled), static_cast<int64>(params.max_volume) * scaling_factor);
+    model_builder.AddLessOrEqual(LinearExpr::WeightedSum(within_pool, volumes), static_cast<int64>(params.max_volume));
+
+    // The value sum is linked to the items once, as total_value, and so is
+    // each category's share of it, as an aggregate variable. Constraints 3-6
+    // are then written over those variables, keeping the model at O(n) terms
+    // rather than one full value sum per ratio constraint.
+    int64 value_sum = 0;
+    for (auto value : values) {
+        value_sum += value;
+    }
+    const IntVar total_value = model_builder.NewIntVar(Domain(0, value_sum));
+    model_builder.AddEquality(LinearExpr::WeightedSum(within_pool, values), total_value);
+
+    // One variable per category equal to the value selected in it. Items are
+    // bucketed by category first, so each item is visited once.
+    std::pmr::vector<IntVar> category_items(&arena);
+    std::pmr::vector<int64> category_values(&arena);
+    category_items.reserve(items.size());
+    category_values.reserve(items.size());
+    auto add_aggregates = [&](std::size_t categories, auto category_of) {
+        std::pmr::vector<std::size_t> starts(categories + 1, 0, &arena);
+        for (const auto & item : items) {
+            ++starts[category_of(item) + 1];
+        }
+        for (std::size_t c = 0; c < categories; ++c) {
+            starts[c + 1] += starts[c];
+        }
+        std::pmr::vector<std::uint32_t> by_category(items.size(), &arena);
+        auto next = starts;
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            by_category[next[category_of(items[i])]++] = static_cast<std::uint32_t>(i);
+        }
+
+        std::pmr::vector<IntVar> aggregates(&arena);
+        aggregates.reserve(categories);
+        for (std::size_t c = 0; c < categories; ++c) {
+            category_items.clear();
+            category_values.clear();
+            int64 category_sum = 0;
+            for (auto k = starts[c]; k < starts[c + 1]; ++k) {
+                category_items.push_back(within_pool[by_category[k]]);
+                category_values.push_back(values[by_category[k]]);
+                category_sum += values[by_category[k]];
+            }
+            aggregates.push_back(model_builder.NewIntVar(Domain(0, category_sum)));
+            model_builder.AddEquality(LinearExpr::WeightedSum(category_items, category_values), aggregates.back());
+        }
+        // Redundant, but lets propagation move between total and shares directly
+        model_builder.AddEquality(LinearExpr::Sum(aggregates), total_value);
+        return aggregates;
+    };
 
     // MAX(SUM(v_i x u_i.value))
-    model_builder.Maximize(LinearExpr::WeightedSum(within_pool, value_scaled));
+    model_builder.Maximize(total_value);
 
     // 3. SUM(v_i x u_i.value) > v_min
-    model_builder.AddGreaterThan(LinearExpr::WeightedSum(within_pool, value_scaled), static_cast<int64>(params.min_value) * scaling_factor);
+    model_builder.AddGreaterThan(total_value, static_cast<int64>(params.min_value));
+
 
     // 4. MAX(v_i x u_i.value) / SUM(p_i.value x c_i) < high_value_max
-    // Rewritten as: MAX(v_i x u_i.value / high_value_max) < SUM(v_i x u_i.value)
+    // Rewritten, with high_value_max = p / q, as: q x MAX(v_i x u_i.value) <= p x SUM(v_i x u_i.value)
 
     switch(constraint_four_setting) {
         case FourthConstraintMode::force_max:
         {
-            model_builder.AddLessOrEqual(LinearExpr::Term(within_pool[max_index], static_cast<int64>(max_value->value) * static_cast<int64>(static_cast<double>(scaling_factor) / params.high_value_max)), LinearExpr::WeightedSum(within_pool, value_scaled));
+            model_builder.AddLessOrEqual(LinearExpr::Term(within_pool[max_index], static_cast<int64>(max_value->value) * value_share.denominator), LinearExpr::Term(total_value, value_share.numerator));
             break;
         }
         case FourthConstraintMode::max_equality:
@@ -167,58 +207,41 @@ Group find_grouping(const vector<Item> & items, const Parameters & params) {
             auto max_value_var = model_builder.NewIntVar(domain_max_var);
 
             model_builder.AddMaxEquality(max_value_var, val_sets);
-            model_builder.AddLessOrEqual(LinearExpr::Term(max_value_var, static_cast<int64>(static_cast<double>(scaling_factor) / params.high_value_max)), LinearExpr::WeightedSum(within_pool, value_scaled));
+            model_builder.AddLessOrEqual(LinearExpr::Term(max_value_var, value_share.denominator), LinearExpr::Term(total_value, value_share.numerator));
             break;
         }
         case FourthConstraintMode::max_all:
         {
             for(size_t i = 0; i < items.size(); ++i)
             {
-                model_builder.AddLessOrEqual(LinearExpr::Term(within_pool[i], static_cast<int64>(items[i].value) * static_cast<int64>(static_cast<double>(scaling_factor) / params.high_value_max)), LinearExpr::WeightedSum(within_pool, value_scaled));
+                model_builder.AddLessOrEqual(LinearExpr::Term(within_pool[i], static_cast<int64>(items[i].value) * value_share.denominator), LinearExpr::Term(total_value, value_share.numerator));
             }
             break;
         }
     }
 
     // 5. SUM(v_i x u_i.value if p_i.product_type == type) / SUM(v_i x u_i.value) <= type_value_max
-    // Rewritten as: SUM(v_i x u_i.value / type_value_max if p_i.product_type == type) <= SUM(v_i x u_i.value)
-    for (auto prod_type : product_types)
+    // Rewritten, with type_value_max = p / q, as: q x type_value[type] <= p x total_value
+    const auto type_values = add_aggregates(catalog.types.size(), [](const Item & item) { return item.type; });
+    for (const auto & type_value : type_values)
     {
-        vector<IntVar> product_type;
-        vector<int64> coeff;
-        for(size_t i = 0; i < items.size(); ++i)
-        {
-            if (items[i].type != prod_type)
-            {
-                continue;
-            }
-
-            product_type.push_back(within_pool[i]);
-            coeff.push_back(static_cast<int64>(items[i].value) * static_cast<int64>(static_cast<double>(scaling_factor) / params.high_type_max));
-        }
-
-        model_builder.AddLessOrEqual(LinearExpr::WeightedSum(product_type, coeff), LinearExpr::WeightedSum(within_pool, value_scaled));
+        model_builder.AddLessOrEqual(LinearExpr::Term(type_value, type_share.denominator), LinearExpr::Term(total_value, type_share.numerator));
     }
 
     // 6. SUM(p_i.value x c_i if p_i.manufacturer == manufacturer) / SUM(p_i.value x c_i) <= man_value_max
-    // Rewritten as: SUM(p_i.value / man_value_max x c_i if p_i.manufacturer == manufacturer) <= SUM(p_i.value x c_i)
-    for (auto manufacturer_type : manufacturer_types)
+    // Rewritten, with man_value_max = p / q, as: q x man_value[manufacturer] <= p x total_value
+    const auto man_values = add_aggregates(catalog.manufacturers.size(), [](const Item & item) { return item.manufacturer; });
+    for (const auto & man_value : man_values)
     {
-        vector<IntVar> man_value;
-        vector<int64> coeff;
-        for(size_t i = 0; i < items.size(); ++i)
-        {
-            if (items[i].manufacturer != manufacturer_type)
-            {
-                continue;
-            }
+        model_builder.AddLessOrEqual(LinearExpr::Term(man_value, man_share.denominator), LinearExpr::Term(total_value, man_share.numerator));
+    }
 
-            man_value.push_back(within_pool[i]);
-            // coeff.push_back(static_cast<int64>(items[i].value));
-            coeff.push_back(static_cast<int64>(items[i].value) * static_cast<int64>(static_cast<double>(scaling_factor) / params.high_man_max));
+    // CP-SAT tries the hinted assignment first and repairs what of it the
+    // model rejects, so a good incumbent gives it a first solution at once
+    if (hint != nullptr) {
+        for (size_t i = 0; i < items.size(); ++i) {
+            model_builder.AddHint(within_pool[i], hint->test(i) ? 1 : 0);
         }
-
-        model_builder.AddLessOrEqual(LinearExpr::WeightedSum(man_value, coeff), LinearExpr::WeightedSum(within_pool, value_scaled));
     }
 
     // Run model
@@ -228,13 +251,59 @@ Group find_grouping(const vector<Item> & items, const Parameters & params) {
     SatParameters parameters;
     parameters.set_num_search_workers(4);
 
-    int max_time = 3 * 60;
-    parameters.set_max_time_in_seconds(max_time);
+    parameters.set_max_time_in_seconds(termination.time_limit);
+    if (termination.relative_gap > 0) {
+        parameters.set_relative_gap_limit(termination.relative_gap);
+    }
+    if (termination.absolute_gap > 0) {
+        parameters.set_absolute_gap_limit(termination.absolute_gap);
+    }
     model.Add(NewSatParameters(parameters));
 
+    // CP-SAT has no stall limit of its own; the watch raises this flag instead
+    std::atomic<bool> stop = false;
+    model.GetOrCreate<TimeLimit>()->RegisterExternalBooleanAsLimit(&stop);
+    StallWatch stall(termination.stall_seconds, [&stop] { stop = true; });
+
+    // Every solution CP-SAT finds passes through here: the first one's time is
+    // kept for --timings, and with --anytime each improving one is logged
+    std::optional<SolutionLog> anytime;
+    if (options.has("anytime")) {
+        anytime.emplace(options.get("anytime"));
+    }
+    const auto start = std::chrono::steady_clock::now();
+    double first_solution = -1;
+    model.Add(NewFeasibleSolutionObserver([&](const CpSolverResponse & solution) {
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (first_solution < 0) {
+            first_solution = seconds;
+        }
+        stall.improved();
+        if (anytime) {
+            std::size_t count = 0;
+            for (const auto & var : within_pool) {
+                count += SolutionIntegerValue(solution, var) >= 1 ? 1u : 0u;
+            }
+            anytime->record(seconds, solution.objective_value(), solution.best_objective_bound(), count);
+        }
+    }));
+
     const CpSolverResponse response = SolveCpModel(model_builder.Build(), &model);
+    stall.finish();
 
     cout << "Resp Status: " << ProtoEnumToString<CpSolverStatus>(response.status()) << endl;
+    cout << "Stop: " << stop_reason(response.status() == CpSolverStatus::OPTIMAL, response.status() == CpSolverStatus::INFEASIBLE,
+        stall.fired(), response.objective_value(), response.best_objective_bound()) << endl;
+    if (options.has("timings")) {
+        cout << "Timings: " << (hint != nullptr ? "hinted" : "cold") << ", first solution ";
+        if (first_solution < 0) {
+            cout << "none";
+        } else {
+            cout << "after " << first_solution << " s";
+        }
+        cout << ", " << (response.status() == CpSolverStatus::OPTIMAL ? "optimal" : "stopped")
+            << " after " << response.wall_time() << " s" << endl;
+    }
 
     if (
         response.status() != CpSolverStatus::OPTIMAL &&
@@ -248,51 +317,41 @@ Group find_grouping(const vector<Item> & items, const Parameters & params) {
     {
         if (SolutionIntegerValue(response, within_pool[i]) >= 1)
         {
-            selected.push_back(items[i]);
+            selected.set(i);
         }
     }
 
     return selected;
 }
 
-template<typename V>
-void to_json(nlohmann::json & j, const vector<V> & p)
-{
-  for (auto & item: p)
-  {
-    nlohmann::json inner;
-    to_json(inner, item);
-    j.push_back(inner);
-  }
-}
-
-void to_json(nlohmann::json & j, const Item & i)
+// Keys in alphabetical order, as nlohmann::json used to write them
+void write_item(ResultWriter & out, const Item & i, const Catalog & catalog)
 {
-    j["value"] = i.value;
-    j["weight"] = i.weight;
-    j["volume"] = i.volume;
-    j["type"] = i.type;
-    j["manufacturer"] = i.manufacturer;
+    out.begin_object();
+    out.key("manufacturer");
+    out.value(catalog.manufacturers.name(i.manufacturer));
+    out.key("type");
+    out.value(catalog.types.name(i.type));
+    out.key("value");
+    out.value(i.value);
+    out.key("volume");
+    out.value(i.volume);
+    out.key("weight");
+    out.value(i.weight);
+    out.end_object();
 }
 
-template<typename V>
-void from_json(const nlohmann::json& j, vector<V> & p)
+void write_chosen(ResultWriter & out, const SelectionMask & p, const Catalog & catalog, bool indices)
 {
-  
-  for (auto & inner: j)
-  {
-    V item;
-    from_json(inner, item);
-    p.push_back(item);
-  }
-}
-
-void from_json(const nlohmann::json& j, Item& p) {
-    j.at("value").get_to(p.value);
-    j.at("weight").get_to(p.weight);
-    j.at("volume").get_to(p.volume);
-    j.at("product_type").get_to(p.type);
-    j.at("manufacturer").get_to(p.manufacturer);
+    out.begin_array();
+    p.for_each([&](std::size_t i) {
+        if (indices) {
+            out.value(i);
+        } else {
+            write_item(out, catalog.items[i], catalog);
+        }
+    });
+    out.end_array();
 }
 
 void from_json(const nlohmann::json& j, Parameters& p) {
@@ -302,6 +361,10 @@ void from_json(const nlohmann::json& j, Parameters& p) {
     j.at("high_value_max").get_to(p.high_value_max);
     j.at("high_man_max").get_to(p.high_man_max);
     j.at("high_type_max").get_to(p.high_type_max);
+    // Share limits are checked as they are read, before anything is solved with them
+    check_share_limit("high_value_max", p.high_value_max);
+    check_share_limit("high_man_max", p.high_man_max);
+    check_share_limit("high_type_max", p.high_type_max);
 }
 
 template<typename V>
@@ -316,48 +379,19 @@ V read_json(const std::string & file_path)
     return data;
 }
 
-pair<Parameters, bool> check_valid(const Group & selected, const Parameters & params)
+pair<Parameters, bool> check_valid(const ItemTable & table, const SelectionMask & selected, const Parameters & params)
 {
-    if (selected.empty()) {
+    if (!selected.any()) {
         return {{}, true};
     }
-    auto total_weight = sum_weight(selected);
-    auto total_volume = sum_volume(selected);
-
-    auto total_value = sum_value(selected);
-
-    auto max_value = std::max_element(selected.cbegin(), selected.cend(), [](auto a, auto b) {
-        return a.value < b.value;
-    });
-
-    unordered_map<string, Amount> prod_types;
-    unordered_map<string, Amount> man_types;
-
-    for(auto item : selected) {
-        auto prod_type = prod_types.find(item.type);
-        if(prod_type != prod_types.end())
-        {
-            prod_type->second += item.value;
-        }
-        else
-        {
-            prod_types[item.type] = item.value;
-        }
-
-        auto man_type = man_types.find(item.manufacturer);
-        if(man_type != man_types.end())
-        {
-            man_type->second += item.value;
-        }
-        else
-        {
-            man_types[item.manufacturer] = item.value;
-        }        
-    }
+    auto total_weight = table.sum_weight(selected);
+    auto total_volume = table.sum_volume(selected);
+    auto total_value = table.sum_value(selected);
+    auto max_value = table.max_value(selected);
 
     double max_prod_type = 0.0;
     bool invalid_prods = false;
-    for (auto [ptype, amount] : prod_types)
+    for (auto amount : table.value_by_type(selected))
     {
         auto prod_type = static_cast<double>(amount) / static_cast<double>(total_value);
         if (prod_type > max_prod_type)
@@ -369,7 +403,7 @@ pair<Parameters, bool> check_valid(const Group & selected, const Parameters & pa
 
     double max_man_type = 0.0;
     bool invalid_mans = false;
-    for (auto [mtype, amount] : man_types)
+    for (auto amount : table.value_by_manufacturer(selected))
     {
         auto man_type = static_cast<double>(amount) / static_cast<double>(total_value);
         if (man_type > max_man_type)
@@ -379,7 +413,7 @@ pair<Parameters, bool> check_valid(const Group & selected, const Parameters & pa
         invalid_mans = invalid_mans || man_type > params.high_man_max;
     }
 
-    auto max_value_percent = static_cast<double>(max_value->value) / static_cast<double>(total_value);
+    auto max_value_percent = static_cast<double>(max_value) / static_cast<double>(total_value);
 
     return {{total_weight, total_volume, total_value, max_value_percent, max_man_type, max_prod_type},
         total_weight > params.max_weight || total_volume > params.max_volume ||
@@ -387,48 +421,67 @@ pair<Parameters, bool> check_valid(const Group & selected, const Parameters & pa
         invalid_prods || invalid_mans };
 }
 
-void print_results(const Group & chosen, const Parameters & params)
+void print_results(const Catalog & catalog, const ItemTable & table, const SelectionMask & chosen, const Parameters & params,
+    const Options & options)
 {
-    auto [val_params, invalid] = check_valid(chosen, params);
+    auto [val_params, invalid] = check_valid(table, chosen, params);
 
-    if (invalid) {
-        cout << "Invalid";
-    } else {
-        cout << "Valid";
-    }
+    ResultWriter out(!options.has("compact"));
+    out << (invalid ? "Invalid" : "Valid");
     
-    cout << " Parameters" << endl;
-    cout << "Value: " << val_params.min_value << endl;
-    cout << "Weight: " << val_params.max_weight << endl;
-    cout << "Volume: " << val_params.max_volume << endl;
+    out << " Parameters\n";
+    out << "Value: " << val_params.min_value << '\n';
+    out << "Weight: " << val_params.max_weight << '\n';
+    out << "Volume: " << val_params.max_volume << '\n';
 
-    cout << "Max Percent of total: " << val_params.high_value_max << endl;
-    cout << "Man Types: " << val_params.high_man_max << endl;
-    cout << "Prod Types: " << val_params.high_type_max << endl;
+    out << "Max Percent of total: " << val_params.high_value_max << '\n';
+    out << "Man Types: " << val_params.high_man_max << '\n';
+    out << "Prod Types: " << val_params.high_type_max << '\n';
 
-    cout << endl;
-    cout << "Chosen:" << endl;
+    out << '\n';
+    out << "Chosen:\n";
 
-    nlohmann::json data;
-    to_json(data, chosen);
+    write_chosen(out, chosen, catalog, options.has("indices"));
+    out << '\n';
 
-    cout << data.dump(4) << endl;
+    cout.flush();
+    out.write(options.get("output"));
 }
 
-void parse_args(int argc, char * argv[], vector<Item> & items, Parameters & params) {
-    if (argc == 3) {
-        const char * cur_val = *(argv+1);
-        string itemsPath(cur_val, std::char_traits<char>::length(cur_val));
-        items = read_json<vector<Item>>(itemsPath);
-
-        const char * cur_val2 = *(argv+2);
-        string paramPath(cur_val2, std::char_traits<char>::length(cur_val2));
-        params = read_json<Parameters>(paramPath);
+// Usage: cpsolver_example_2 [items.json params.json] [options]
+//   --loader=L        mmap (default; maps the items file and parses it in place), parallel (the same,
+//                     parsed in chunks on --threads threads) or sax; the mmap loaders also read
+//                     binary catalogs written by catalog_convert
+//   --threads=N       threads for --loader=parallel (default: all cores)
+//   --no-core         hand the solver the whole catalog instead of the core left by reduce_to_core
+//   --core-search=N   kicks of local search on the incumbent that sets the core's bounds (default: 20)
+//   --no-hint         start the solver cold instead of from the incumbent
+//   --timings         print when the solver found its first solution and when it finished
+//   --anytime[=PATH]  log each improving solution as it is found, one JSON line with its time
+//                     in seconds, objective, bound and item count, to PATH or stdout
+//   --gap=G           stop once the solver's bound is within a fraction G of its best solution
+//   --abs-gap=A       stop once the bound is within A of the best solution
+//   --stall=S         stop after S seconds without an improving solution
+//   --deadline=S      seconds the whole run may take; the solver gets what loading and the
+//                     core reduction leave of it (default: a 180 s solver limit)
+//   --compact         print the chosen items as compact JSON instead of indented
+//   --indices         print the chosen items' catalog indices instead of the items
+//   --output=PATH     write the results to PATH instead of stdout
+//   --alloc-report    print the heap allocations made while loading, solving and writing to stderr
+//                     (counted only when built with CPSOLVER_COUNT_ALLOCATIONS)
+void parse_args(int argc, char * argv[], Catalog & catalog, Parameters & params, Options & options) {
+    options = Options(argc, argv);
+    const auto & paths = options.positional();
+    if (paths.size() == 2) {
+        catalog = load_catalog<nlohmann::json>(paths[0], options);
+        params = read_json<Parameters>(paths[1]);
     }
 }
 
 // Should output:
+// Core: 5 of 6 items undecided (1 fixed in, 0 fixed out)
 // Resp Status: OPTIMAL
+// Stop: optimal
 // Valid Parameters
 // Value: 18
 // Weight: 18
@@ -469,15 +522,56 @@ void parse_args(int argc, char * argv[], vector<Item> & items, Parameters & para
 //     }
 // ]
 int main(int argc, char * argv[]) {
-    vector<Item> items = { {9, 10, 10, "a", "p1"}, {3, 4, 9, "b", "p2"}, {3, 5, 2, "c", "p1"}, {6, 4, 4, "c", "p1"}, {3, 2, 2, "c", "p2"}, {3, 1, 1, "c", "p2"} };
+    AllocationReport allocations;
+    const auto started = std::chrono::steady_clock::now();
+
+    Catalog catalog = { {9, 10, 10, "a", "p1"}, {3, 4, 9, "b", "p2"}, {3, 5, 2, "c", "p1"}, {6, 4, 4, "c", "p1"}, {3, 2, 2, "c", "p2"}, {3, 1, 1, "c", "p2"} };
 
     Parameters params = {20, 20, 10, 0.8, 0.7, 0.7};
 
-    parse_args(argc, argv, items, params);
+    Options options;
+    parse_args(argc, argv, catalog, params, options);
+    allocations.mark("load");
+
+    ItemTable table(catalog);
+
+    SelectionMask chosen;
+    if (options.has("no-core")) {
+        chosen = find_grouping(catalog, params, SelectionMask(catalog.items.size()), nullptr,
+            read_termination(options, started), options);
+    } else {
+        auto incumbent = constrained_greedy(catalog, params, portfolio_order(catalog, params, 3));
+        local_search(catalog, params, incumbent, static_cast<std::size_t>(options.get_long("core-search", 20)));
+        const bool incumbent_valid = !check_valid(table, incumbent, params).second;
+        auto lower_bound = incumbent_valid ? table.sum_value(incumbent) : 0;
+
+        auto core = reduce_to_core(catalog, params, lower_bound);
+        cout << "Core: " << core.undecided() << " of " << catalog.items.size() << " items undecided ("
+            << core.fixed_in.count() << " fixed in, " << core.fixed_out << " fixed out)" << endl;
+
+        if (core.proves_incumbent(params)) {
+            // Nothing can beat the incumbent, so there is no model to solve. An
+            // invalid incumbent sets no bound, so then no selection is valid.
+            cout << "Resp Status: " << (incumbent_valid ? "OPTIMAL" : "INFEASIBLE") << " (core reduction)" << endl;
+            cout << "Stop: " << (incumbent_valid ? "optimal" : "infeasible") << endl;
+            chosen = std::move(incumbent);
+        } else {
+            auto hint = core.restrict(incumbent);
+            chosen = core.expand(find_grouping(core.catalog, params, core.fixed_in, options.has("no-hint") ? nullptr : &hint,
+                read_termination(options, started), options), catalog.items.size());
+            if (check_valid(table, chosen, params).second || table.sum_value(chosen) < lower_bound) {
+                chosen = std::move(incumbent);
+            }
+        }
+    }
 
-    auto chosen = find_grouping(items, params);
+    allocations.mark("solve");
 
-    print_results(chosen, params);
+    print_results(catalog, table, chosen, params, options);
+    allocations.mark("output");
+    if (options.has("alloc-report")) {
+        allocations.print(std::cerr);
+    }
 
     return 0;
 }
\ No newline at end of file
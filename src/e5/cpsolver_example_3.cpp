@@ -4,82 +4,123 @@
 #include <cstdint>
 #include <iostream>
 #include <algorithm>
-#include <unordered_map>
-#include <set>
 #include <fstream>
+#include <chrono>
 #include <memory>
+#include <stdexcept>
 
 #include "ortools/base/logging.h"
 #include "ortools/linear_solver/linear_solver.h"
+#include "ortools/linear_solver/linear_solver_callback.h"
 
 #include "json.hpp"
 
-using Amount = std::uint64_t;
+#include "item.hpp"
+#include "catalog.hpp"
+#include "catalog_loader.hpp"
+#include "parameters.hpp"
+#include "options.hpp"
+#include "selection_mask.hpp"
+#include "item_table.hpp"
+#include "result_writer.hpp"
+#include "termination.hpp"
+#include "allocation_counter.hpp"
+#include "order.hpp"
+#include "portfolio.hpp"
+#include "constrained_greedy.hpp"
+#include "local_search.hpp"
+#include "core_reduction.hpp"
 
 using std::string;
 using std::vector;
 using std::cout;
 using std::endl;
-using std::set;
 using std::pair;
-using std::unordered_map;
 using std::size_t;
 
 using operations_research::MPSolver;
 using operations_research::MPVariable;
+using operations_research::MPConstraint;
 using operations_research::LinearExpr;
 using operations_research::MPObjective;
+using operations_research::MPSolverParameters;
+using operations_research::MPCallback;
+using operations_research::MPCallbackContext;
+using operations_research::MPCallbackEvent;
 
-struct Item {
-    Amount value;
-    Amount weight;
-    Amount volume;
-    string manufacturer;
-    string type;
-};
+using int64 = int64_t;
 
-using Group = vector<Item>;
+enum class FourthConstraintMode {
+    force_max = 0,
+    max_all = 2 };
 
-struct Parameters {
-    Amount max_weight;
-    Amount max_volume;
-    Amount min_value;
-    double high_value_max;
-    double high_man_max;
-    double high_type_max;
-};
+pair<Parameters, bool> check_valid(const ItemTable & table, const SelectionMask & selected, const Parameters & params);
+
+// Sees the solutions SCIP finds as it goes, for --timings and --stall. SCIP
+// calls back with kMipSolution for every candidate it checks, including ones
+// it then rejects, so only candidates that pass check_valid and beat the best
+// so far count as improvements.
+class SolutionWatch : public MPCallback {
+public:
+    SolutionWatch(const Catalog & catalog, const Parameters & params, const vector<const MPVariable*> & within_pool,
+        StallWatch & stall)
+        : MPCallback(false, false), table_(catalog), params_(params), within_pool_(within_pool), stall_(stall),
+        candidate_(catalog.items.size())
+    {
+    }
 
-constexpr Amount sum_value(const Group & selected) {
-    return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-        [](const Amount & a, const Item & b) {
-            return a + b.value;
+    void RunCallback(MPCallbackContext * context) override
+    {
+        if (context->Event() != MPCallbackEvent::kMipSolution || !context->CanQueryVariableValues()) {
+            return;
         }
-    );
-}
-
-constexpr Amount sum_weight(const Group & selected) {
-    return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-        [](const Amount & a, const Item & b) {
-            return a + b.weight;
+        candidate_.clear();
+        for (size_t i = 0; i < within_pool_.size(); ++i) {
+            if (context->VariableValue(within_pool_[i]) >= 0.5) {
+                candidate_.set(i);
+            }
         }
-    );
-}
-
-constexpr Amount sum_volume(const Group & selected) {
-   return accumulate(selected.cbegin(), selected.cend(), static_cast<Amount>(0),
-        [](const Amount & a, const Item & b) {
-            return a + b.volume;
+        if (check_valid(table_, candidate_, params_).second) {
+            return;
         }
-    );
-}
-
-using int64 = int64_t;
+        if (first_solution_ < 0) {
+            first_solution_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        }
+        auto value = table_.sum_value(candidate_);
+        if (value > best_value_) {
+            best_value_ = value;
+            stall_.improved();
+        }
+    }
 
-enum class FourthConstraintMode {
-    force_max = 0,
-    max_all = 2 };
+    // Seconds from construction to the first valid solution, or -1 if none came
+    double first_solution() const { return first_solution_; }
+
+private:
+    ItemTable table_;
+    const Parameters & params_;
+    const vector<const MPVariable*> & within_pool_;
+    StallWatch & stall_;
+    SelectionMask candidate_;
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+    double first_solution_ = -1;
+    Amount best_value_ = 0;
+};
 
-Group find_grouping(const vector<Item> & items, const Parameters & params) {
+// `hint`, if given, is a selection over catalog.items to start the search from
+SelectionMask find_grouping(const Catalog & catalog, const Parameters & params, const SelectionMask & fixed_in,
+    const SelectionMask * hint, const Termination & termination, const Options & options) {
+    const auto & items = catalog.items;
+
+    // The model is built around the most valuable item, so it needs one. With
+    // no items only the empty selection is left, which meets constraint 3
+    // only for a zero min_value.
+    if (items.empty()) {
+        const bool feasible = params.min_value == 0;
+        cout << "Resp Status: " << (feasible ? "OPTIMAL" : "INFEASIBLE") << " (no items)" << endl;
+        cout << "Stop: " << (feasible ? "optimal" : "infeasible") << endl;
+        return {};
+    }
 
     std::unique_ptr<MPSolver> solver(MPSolver::CreateSolver("SCIP"));
     if (!solver) {
@@ -87,13 +128,11 @@ Group find_grouping(const vector<Item> & items, const Parameters & params) {
         return {};
     }
     
-    Group selected;
+    SelectionMask selected(items.size());
 
     // Define variables
     vector<const MPVariable*> within_pool(items.size());
 
-    set<string> product_types;  
-    set<string> manufacturer_types;
 
     auto max_value = std::max_element(items.cbegin(), items.cend(), [](auto a, auto b) {
         return a.value < b.value;
@@ -112,15 +151,12 @@ Group find_grouping(const vector<Item> & items, const Parameters & params) {
         if (constraint_four_setting == FourthConstraintMode::force_max && i == max_index) {
             within_pool[i] = solver->MakeIntVar(1, 1, "");
         } else {
-            within_pool[i] = solver->MakeIntVar(0, 1, "");
+            within_pool[i] = solver->MakeIntVar(fixed_in.test(i) ? 1 : 0, 1, "");
         }
 
         in_pool_weight_sum += LinearExpr(within_pool[i]) * static_cast<double>(items[i].weight);
         in_pool_volume_sum += LinearExpr(within_pool[i]) * static_cast<double>(items[i].volume);
         in_pool_value_sum += LinearExpr(within_pool[i]) * static_cast<double>(items[i].value);
-
-        product_types.insert(items[i].type);
-        manufacturer_types.insert(items[i].manufacturer);
     }
 
     // Define constraints
@@ -158,41 +194,43 @@ Group find_grouping(const vector<Item> & items, const Parameters & params) {
         }
     }
 
-    // 5. SUM(v_i x u_i.value if p_i.product_type == type) / SUM(v_i x u_i.value) <= type_value_max
-    // Rewritten as: SUM(v_i x u_i.value / type_value_max if p_i.product_type == type) <= SUM(v_i x u_i.value)
-    for (auto prod_type : product_types)
-    {
-        LinearExpr prod_type_sum;
-
+    // Rows 5 and 6 are set coefficient by coefficient rather than as
+    // LinearExpr sums: each `sum <= in_pool_value_sum` would copy the whole
+    // value sum into a fresh hash map for every category. Moving the right
+    // side over, an item of the category gets value / max - value, any other
+    // item -value, and the row is <= 0.
+    auto add_share_row = [&](auto in_category, double share_max) {
+        MPConstraint * const row = solver->MakeRowConstraint(-solver->infinity(), 0);
         for(size_t i = 0; i < items.size(); ++i)
         {
-            if (items[i].type != prod_type)
-            {
-                continue;
-            }
-
-            prod_type_sum += LinearExpr(within_pool[i]) * (static_cast<double>(items[i].value) / params.high_type_max);
+            auto value = static_cast<double>(items[i].value);
+            row->SetCoefficient(within_pool[i], in_category(items[i]) ? value / share_max - value : -value);
         }
-        solver->MakeRowConstraint(prod_type_sum <= in_pool_value_sum);
+    };
+
+    // 5. SUM(v_i x u_i.value if p_i.product_type == type) / SUM(v_i x u_i.value) <= type_value_max
+    // Rewritten as: SUM(v_i x u_i.value / type_value_max if p_i.product_type == type) <= SUM(v_i x u_i.value)
+    for (CategoryId prod_type = 0; prod_type < catalog.types.size(); ++prod_type)
+    {
+        add_share_row([prod_type](const Item & item) { return item.type == prod_type; }, params.high_type_max);
     }
 
     // 6. SUM(p_i.value x c_i if p_i.manufacturer == manufacturer) / SUM(p_i.value x c_i) <= man_value_max
     // Rewritten as: SUM(p_i.value / man_value_max x c_i if p_i.manufacturer == manufacturer) <= SUM(p_i.value x c_i)
-    for (auto manufacturer_type : manufacturer_types)
+    for (CategoryId manufacturer_type = 0; manufacturer_type < catalog.manufacturers.size(); ++manufacturer_type)
     {
-        LinearExpr man_type_sum;
-
-        for(size_t i = 0; i < items.size(); ++i)
-        {
-            if (items[i].manufacturer != manufacturer_type)
-            {
-                continue;
-            }
+        add_share_row([manufacturer_type](const Item & item) { return item.manufacturer == manufacturer_type; }, params.high_man_max);
+    }
 
-            man_type_sum += LinearExpr(within_pool[i]) * (static_cast<double>(items[i].value) / params.high_man_max);
+    // SCIP checks the hint as its first primal solution; one that the model
+    // accepts sets the incumbent before any branching
+    if (hint != nullptr) {
+        std::vector<std::pair<const MPVariable *, double>> hinted;
+        hinted.reserve(items.size());
+        for (size_t i = 0; i < items.size(); ++i) {
+            hinted.emplace_back(within_pool[i], hint->test(i) ? 1.0 : 0.0);
         }
-
-        solver->MakeRowConstraint(man_type_sum <= in_pool_value_sum);
+        solver->SetHint(std::move(hinted));
     }
 
     auto status = solver->SetNumThreads(4);
@@ -203,16 +241,49 @@ Group find_grouping(const vector<Item> & items, const Parameters & params) {
         std::cout << "Invalid threads" << std::endl;
     }
 
-    int max_time = 3 * 60;
+    solver->set_time_limit(static_cast<int64>(termination.time_limit * 1000));
 
-    solver->set_time_limit(max_time * 1000);
+    // MPSolver's defaults (a relative gap of 1e-4) unless told otherwise.
+    // SCIP has no stall limit of its own; the watch interrupts the solve.
+    MPSolverParameters solve_parameters;
+    if (termination.relative_gap > 0) {
+        solve_parameters.SetDoubleParam(MPSolverParameters::RELATIVE_MIP_GAP, termination.relative_gap);
+    }
+    if (termination.absolute_gap > 0) {
+        solver->SetSolverSpecificParametersAsString("limits/absgap = " + std::to_string(termination.absolute_gap));
+    }
+
+    StallWatch stall(termination.stall_seconds, [&solver] { solver->InterruptSolve(); });
+    // The callback has SCIP check every candidate with it, so it is only set
+    // when something reads what it sees
+    SolutionWatch watch(catalog, params, within_pool, stall);
+    if ((options.has("timings") || termination.stall_seconds > 0) && solver->SupportsCallbacks()) {
+        solver->SetCallback(&watch);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const MPSolver::ResultStatus result_status = solver->Solve(solve_parameters);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stall.finish();
+    solver->SetCallback(nullptr);
 
-    const MPSolver::ResultStatus result_status = solver->Solve();
+    const bool solved = result_status == MPSolver::OPTIMAL || result_status == MPSolver::FEASIBLE;
 
     cout << "Resp Status: " << result_status << endl;
+    // The objective and bound are only defined once a solution was found
+    cout << "Stop: " << stop_reason(result_status == MPSolver::OPTIMAL, result_status == MPSolver::INFEASIBLE, stall.fired(),
+        solved ? objective->Value() : 0, solved ? objective->BestBound() : 0) << endl;
+    if (options.has("timings")) {
+        cout << "Timings: " << (hint != nullptr ? "hinted" : "cold") << ", first solution ";
+        if (watch.first_solution() < 0) {
+            cout << "none";
+        } else {
+            cout << "after " << watch.first_solution() << " s";
+        }
+        cout << ", " << (result_status == MPSolver::OPTIMAL ? "optimal" : "stopped") << " after " << elapsed.count() << " s" << endl;
+    }
 
-    if (result_status != MPSolver::OPTIMAL &&
-        result_status != MPSolver::FEASIBLE) {
+    if (!solved) {
         // not solution
         return {};
     }
@@ -221,51 +292,41 @@ Group find_grouping(const vector<Item> & items, const Parameters & params) {
     {
         if (within_pool[i]->solution_value() >= 1)
         {
-            selected.push_back(items[i]);
+            selected.set(i);
         }
     }
 
     return selected;
 }
 
-template<typename V>
-void to_json(nlohmann::json & j, const vector<V> & p)
+// Keys in alphabetical order, as nlohmann::json used to write them
+void write_item(ResultWriter & out, const Item & i, const Catalog & catalog)
 {
-  for (auto & item: p)
-  {
-    nlohmann::json inner;
-    to_json(inner, item);
-    j.push_back(inner);
-  }
+    out.begin_object();
+    out.key("manufacturer");
+    out.value(catalog.manufacturers.name(i.manufacturer));
+    out.key("type");
+    out.value(catalog.types.name(i.type));
+    out.key("value");
+    out.value(i.value);
+    out.key("volume");
+    out.value(i.volume);
+    out.key("weight");
+    out.value(i.weight);
+    out.end_object();
 }
 
-void to_json(nlohmann::json & j, const Item & i)
+void write_chosen(ResultWriter & out, const SelectionMask & p, const Catalog & catalog, bool indices)
 {
-    j["value"] = i.value;
-    j["weight"] = i.weight;
-    j["volume"] = i.volume;
-    j["type"] = i.type;
-    j["manufacturer"] = i.manufacturer;
-}
-
-template<typename V>
-void from_json(const nlohmann::json& j, vector<V> & p)
-{
-  
-  for (auto & inner: j)
-  {
-    V item;
-    from_json(inner, item);
-    p.push_back(item);
-  }
-}
-
-void from_json(const nlohmann::json& j, Item& p) {
-    j.at("value").get_to(p.value);
-    j.at("weight").get_to(p.weight);
-    j.at("volume").get_to(p.volume);
-    j.at("product_type").get_to(p.type);
-    j.at("manufacturer").get_to(p.manufacturer);
+    out.begin_array();
+    p.for_each([&](std::size_t i) {
+        if (indices) {
+            out.value(i);
+        } else {
+            write_item(out, catalog.items[i], catalog);
+        }
+    });
+    out.end_array();
 }
 
 void from_json(const nlohmann::json& j, Parameters& p) {
@@ -289,48 +350,19 @@ V read_json(const std::string & file_path)
     return data;
 }
 
-pair<Parameters, bool> check_valid(const Group & selected, const Parameters & params)
+pair<Parameters, bool> check_valid(const ItemTable & table, const SelectionMask & selected, const Parameters & params)
 {
-    if (selected.empty()) {
+    if (!selected.any()) {
         return {{}, true};
     }
-    auto total_weight = sum_weight(selected);
-    auto total_volume = sum_volume(selected);
-
-    auto total_value = sum_value(selected);
-
-    auto max_value = std::max_element(selected.cbegin(), selected.cend(), [](auto a, auto b) {
-        return a.value < b.value;
-    });
-
-    unordered_map<string, Amount> prod_types;
-    unordered_map<string, Amount> man_types;
-
-    for(auto item : selected) {
-        auto prod_type = prod_types.find(item.type);
-        if(prod_type != prod_types.end())
-        {
-            prod_type->second += item.value;
-        }
-        else
-        {
-            prod_types[item.type] = item.value;
-        }
-
-        auto man_type = man_types.find(item.manufacturer);
-        if(man_type != man_types.end())
-        {
-            man_type->second += item.value;
-        }
-        else
-        {
-            man_types[item.manufacturer] = item.value;
-        }        
-    }
+    auto total_weight = table.sum_weight(selected);
+    auto total_volume = table.sum_volume(selected);
+    auto total_value = table.sum_value(selected);
+    auto max_value = table.max_value(selected);
 
     double max_prod_type = 0.0;
     bool invalid_prods = false;
-    for (auto [ptype, amount] : prod_types)
+    for (auto amount : table.value_by_type(selected))
     {
         auto prod_type = static_cast<double>(amount) / static_cast<double>(total_value);
         if (prod_type > max_prod_type)
@@ -342,7 +374,7 @@ pair<Parameters, bool> check_valid(const Group & selected, const Parameters & pa
 
     double max_man_type = 0.0;
     bool invalid_mans = false;
-    for (auto [mtype, amount] : man_types)
+    for (auto amount : table.value_by_manufacturer(selected))
     {
         auto man_type = static_cast<double>(amount) / static_cast<double>(total_value);
         if (man_type > max_man_type)
@@ -352,7 +384,7 @@ pair<Parameters, bool> check_valid(const Group & selected, const Parameters & pa
         invalid_mans = invalid_mans || man_type > params.high_man_max;
     }
 
-    auto max_value_percent = static_cast<double>(max_value->value) / static_cast<double>(total_value);
+    auto max_value_percent = static_cast<double>(max_value) / static_cast<double>(total_value);
 
     return {{total_weight, total_volume, total_value, max_value_percent, max_man_type, max_prod_type},
         total_weight > params.max_weight || total_volume > params.max_volume ||
@@ -360,49 +392,67 @@ pair<Parameters, bool> check_valid(const Group & selected, const Parameters & pa
         invalid_prods || invalid_mans };
 }
 
-void print_results(const Group & chosen, const Parameters & params)
+void print_results(const Catalog & catalog, const ItemTable & table, const SelectionMask & chosen, const Parameters & params,
+    const Options & options)
 {
-    auto [val_params, invalid] = check_valid(chosen, params);
+    auto [val_params, invalid] = check_valid(table, chosen, params);
 
-    if (invalid) {
-        cout << "Invalid";
-    } else {
-        cout << "Valid";
-    }
+    ResultWriter out(!options.has("compact"));
+    out << (invalid ? "Invalid" : "Valid");
     
-    cout << " Parameters" << endl;
-    cout << "Value: " << val_params.min_value << endl;
-    cout << "Weight: " << val_params.max_weight << endl;
-    cout << "Volume: " << val_params.max_volume << endl;
+    out << " Parameters\n";
+    out << "Value: " << val_params.min_value << '\n';
+    out << "Weight: " << val_params.max_weight << '\n';
+    out << "Volume: " << val_params.max_volume << '\n';
 
-    cout << "Max Percent of total: " << val_params.high_value_max << endl;
-    cout << "Man Types: " << val_params.high_man_max << endl;
-    cout << "Prod Types: " << val_params.high_type_max << endl;
+    out << "Max Percent of total: " << val_params.high_value_max << '\n';
+    out << "Man Types: " << val_params.high_man_max << '\n';
+    out << "Prod Types: " << val_params.high_type_max << '\n';
 
-    cout << endl;
-    cout << "Chosen:" << endl;
+    out << '\n';
+    out << "Chosen:\n";
 
-    nlohmann::json data;
-    to_json(data, chosen);
+    write_chosen(out, chosen, catalog, options.has("indices"));
+    out << '\n';
 
-    cout << data.dump(4) << endl;
+    cout.flush();
+    out.write(options.get("output"));
 }
 
-void parse_args(int argc, char * argv[], vector<Item> & items, Parameters & params) {
-    if (argc == 3) {
-        const char * cur_val = *(argv+1);
-        string itemsPath(cur_val, std::char_traits<char>::length(cur_val));
-        items = read_json<vector<Item>>(itemsPath);
-
-        const char * cur_val2 = *(argv+2);
-        string paramPath(cur_val2, std::char_traits<char>::length(cur_val2));
-        params = read_json<Parameters>(paramPath);
+// Usage: cpsolver_example_3 [items.json params.json] [options]
+//   --loader=L        mmap (default; maps the items file and parses it in place), parallel (the same,
+//                     parsed in chunks on --threads threads) or sax; the mmap loaders also read
+//                     binary catalogs written by catalog_convert
+//   --threads=N       threads for --loader=parallel (default: all cores)
+//   --no-core         hand the solver the whole catalog instead of the core left by reduce_to_core
+//   --core-search=N   kicks of local search on the incumbent that sets the core's bounds (default: 20)
+//   --no-hint         start the solver cold instead of from the incumbent
+//   --timings         print when the solver found its first solution and when it finished
+//   --gap=G           stop once the solver's bound is within a fraction G of its best solution
+//                     (default: MPSolver's 1e-4)
+//   --abs-gap=A       stop once the bound is within A of the best solution
+//   --deadline=S      seconds the whole run may take; the solver gets what loading and the
+//                     core reduction leave of it (default: a 180 s solver limit)
+//   --stall=S         stop after S seconds without an improving solution
+//   --compact         print the chosen items as compact JSON instead of indented
+//   --indices         print the chosen items' catalog indices instead of the items
+//   --output=PATH     write the results to PATH instead of stdout
+//   --alloc-report    print the heap allocations made while loading, solving and writing to stderr
+//                     (counted only when built with CPSOLVER_COUNT_ALLOCATIONS)
+void parse_args(int argc, char * argv[], Catalog & catalog, Parameters & params, Options & options) {
+    options = Options(argc, argv);
+    const auto & paths = options.positional();
+    if (paths.size() == 2) {
+        catalog = load_catalog<nlohmann::json>(paths[0], options);
+        params = read_json<Parameters>(paths[1]);
     }
 }
 
 // Should output:
+// Core: 5 of 6 items undecided (1 fixed in, 0 fixed out)
 // Valid threads
 // Resp Status: MPSOLVER_OPTIMAL
+// Stop: optimal
 // Valid Parameters
 // Value: 18
 // Weight: 18
@@ -443,15 +493,56 @@ void parse_args(int argc, char * argv[], vector<Item> & items, Parameters & para
 //     }
 // ]
 int main(int argc, char * argv[]) {
-    vector<Item> items = { {9, 10, 10, "a", "p1"}, {3, 4, 9, "b", "p2"}, {3, 5, 2, "c", "p1"}, {6, 4, 4, "c", "p1"}, {3, 2, 2, "c", "p2"}, {3, 1, 1, "c", "p2"} };
+    AllocationReport allocations;
+    const auto started = std::chrono::steady_clock::now();
+
+    Catalog catalog = { {9, 10, 10, "a", "p1"}, {3, 4, 9, "b", "p2"}, {3, 5, 2, "c", "p1"}, {6, 4, 4, "c", "p1"}, {3, 2, 2, "c", "p2"}, {3, 1, 1, "c", "p2"} };
 
     Parameters params = {20, 20, 10, 0.8, 0.7, 0.7};
 
-    parse_args(argc, argv, items, params);
+    Options options;
+    parse_args(argc, argv, catalog, params, options);
+    allocations.mark("load");
 
-    auto chosen = find_grouping(items, params);
+    ItemTable table(catalog);
 
-    print_results(chosen, params);
+    SelectionMask chosen;
+    if (options.has("no-core")) {
+        chosen = find_grouping(catalog, params, SelectionMask(catalog.items.size()), nullptr,
+            read_termination(options, started), options);
+    } else {
+        auto incumbent = constrained_greedy(catalog, params, portfolio_order(catalog, params, 3));
+        local_search(catalog, params, incumbent, static_cast<std::size_t>(options.get_long("core-search", 20)));
+        const bool incumbent_valid = !check_valid(table, incumbent, params).second;
+        auto lower_bound = incumbent_valid ? table.sum_value(incumbent) : 0;
+
+        auto core = reduce_to_core(catalog, params, lower_bound);
+        cout << "Core: " << core.undecided() << " of " << catalog.items.size() << " items undecided ("
+            << core.fixed_in.count() << " fixed in, " << core.fixed_out << " fixed out)" << endl;
+
+        if (core.proves_incumbent(params)) {
+            // Nothing can beat the incumbent, so there is no model to solve. An
+            // invalid incumbent sets no bound, so then no selection is valid.
+            cout << "Resp Status: " << (incumbent_valid ? "OPTIMAL" : "INFEASIBLE") << " (core reduction)" << endl;
+            cout << "Stop: " << (incumbent_valid ? "optimal" : "infeasible") << endl;
+            chosen = std::move(incumbent);
+        } else {
+            auto hint = core.restrict(incumbent);
+            chosen = core.expand(find_grouping(core.catalog, params, core.fixed_in, options.has("no-hint") ? nullptr : &hint,
+                read_termination(options, started), options), catalog.items.size());
+            if (check_valid(table, chosen, params).second || table.sum_value(chosen) < lower_bound) {
+                chosen = std::move(incumbent);
+            }
+        }
+    }
+
+    allocations.mark("solve");
+
+    print_results(catalog, table, chosen, params, options);
+    allocations.mark("output");
+    if (options.has("alloc-report")) {
+        allocations.print(std::cerr);
+    }
 
     return 0;
 }
\ No newline at end of file